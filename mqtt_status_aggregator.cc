@@ -0,0 +1,712 @@
+// MQTT Status Aggregator
+//   Subscribes to the MQTT Status topics of several trunk-recorder instances and republishes one merged view.
+//   Each instance needs a unique instance_id in its trunk-recorder config.
+//
+//   Systems are matched across instances by WACN and system ID from the instance's retained `systems/<short_name>`
+//   and `systems` messages, so calls on a P25 network that is recorded by instances at overlapping sites are
+//   reported once.  Systems without a WACN and system ID (conventional, SmartNet, ...) are kept apart per instance.
+//
+//   Published below the output topic:
+//     calls_active, recorders, rates, instances   retained; sent when they change, ignoring call times and decode
+//                                                 rates, and at least every refresh_seconds
+//     call_start, call_end, unit/<type>           events, with duplicates from other instances removed
+//     units/<system>/<unit>                       retained unit state; sent when a unit's state changes, and
+//                                                 cleared when the unit has been idle for unit_seconds
+//     status                                      retained connected/disconnected status of the aggregator
+//
+//   Usage: mqtt_status_aggregator [options] <topic> [<topic> ...]
+//     <topic>          the "topic" of an instance's plugin config, e.g. trunk-recorder/east
+//     -b broker        default tcp://localhost:1883
+//     -U username
+//     -P password
+//     -u unit_topic    the "unit_topic" of an instance's plugin config; may be given more than once
+//     -o topic         output topic, default trunk-recorder/merged
+//     -i id            instance_id and client_id of the aggregator, default tr-status-aggregator
+//     -w seconds       calls and unit events this close together are duplicates, default 3
+//     -t seconds       unit state expiry, default 600
+//     -r seconds       republish views whose call times or decode rates changed this often, default 15
+//     -z suffix        compress_suffix of the instances, default /zlib
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include <zlib.h>
+#include <mqtt/async_client.h>
+#include <json.hpp>
+
+static std::atomic<bool> running{true};
+
+static void handle_signal(int)
+{
+  running = false;
+}
+
+class Aggregator : public virtual mqtt::callback
+{
+public:
+  std::string broker = "tcp://localhost:1883";
+  std::string username;
+  std::string password;
+  std::string output_topic = "trunk-recorder/merged";
+  std::string client_id = "tr-status-aggregator";
+  std::string compress_suffix = "/zlib";
+  std::vector<std::string> status_topics;
+  std::vector<std::string> unit_topics;
+  int duplicate_seconds = 3;
+  int unit_seconds = 600;
+  int refresh_seconds = 15;
+
+  // start()
+  //   Connect to the broker; subscriptions are made in connected(), so they are restored after a reconnect.
+  bool start()
+  {
+    nlohmann::ordered_json status_json = {{"status", "disconnected"}, {"instance_id", client_id}, {"client_id", client_id}};
+    std::string lwt_str = status_json.dump();
+    mqtt::message will_msg(output_topic + "/status", lwt_str.c_str(), lwt_str.size(), 1, true);
+
+    mqtt::connect_options_builder conn_builder;
+    conn_builder.clean_session()
+        .automatic_reconnect(std::chrono::seconds(1), std::chrono::seconds(30))
+        .will(will_msg);
+    conn_opts = conn_builder.finalize();
+    if ((username != "") && (password != ""))
+    {
+      conn_opts.set_user_name(username);
+      conn_opts.set_password(password);
+    }
+
+    client = new mqtt::async_client(broker, client_id);
+    client->set_callback(*this);
+    try
+    {
+      client->connect(conn_opts)->wait();
+    }
+    catch (const mqtt::exception &exc)
+    {
+      std::cerr << "Unable to connect to " << broker << ": " << exc.what() << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // stop()
+  //   Publish the disconnected status and disconnect cleanly; the broker does not send the LWT for a clean disconnect.
+  void stop()
+  {
+    nlohmann::ordered_json status_json = {{"status", "disconnected"}, {"instance_id", client_id}, {"client_id", client_id}};
+    try
+    {
+      mqtt::delivery_token_ptr status_token = publish(output_topic + "/status", status_json.dump(), true);
+      if (status_token)
+        status_token->wait_for(std::chrono::seconds(5));
+      client->disconnect()->wait_for(std::chrono::seconds(5));
+    }
+    catch (const mqtt::exception &exc)
+    {
+      std::cerr << exc.what() << std::endl;
+    }
+  }
+
+  // tick()
+  //   Called once per second; publish the merged views that changed and expire idle units.
+  void tick()
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    publish_view("calls_active", "calls", get_calls_json(), {"elapsed", "length", "stop_time"});
+    publish_view("recorders", "recorders", get_instance_list_json(&Instance::recorders), {});
+    publish_view("rates", "rates", get_instance_list_json(&Instance::rates), {"decoderate", "decoderate_interval"});
+    publish_view("instances", "instances", get_instances_json(), {});
+
+    int64_t expire_ms = steady_ms() - (unit_seconds * 1000LL);
+    for (std::map<std::string, Unit_State>::iterator it = units.begin(); it != units.end();)
+    {
+      if (it->second.last_ms < expire_ms)
+      {
+        publish(output_topic + "/units/" + it->first, "", true);
+        it = units.erase(it);
+      }
+      else
+        ++it;
+    }
+  }
+
+  // Paho mqtt::callbacks.
+  // connected()
+  //   Paho MQTT: Subscribe to each instance's topics, and publish the connected status.
+  void connected(const std::string &cause) override
+  {
+    std::cerr << "Connected to broker: " << broker << std::endl;
+    std::vector<std::string> topics;
+    for (std::vector<std::string>::iterator it = status_topics.begin(); it != status_topics.end(); ++it)
+    {
+      const std::vector<std::string> types = {"calls_active", "recorders", "rates", "call_start", "call_end"};
+      for (std::vector<std::string>::const_iterator type = types.begin(); type != types.end(); ++type)
+      {
+        topics.push_back(*it + "/" + *type);
+        topics.push_back(*it + "/" + *type + compress_suffix);
+      }
+      // The systems list and each system_state (systems/<short_name>), compressed or not
+      topics.push_back(*it + "/systems/#");
+      if (compress_suffix.compare(0, 1, "/") != 0)
+        topics.push_back(*it + "/systems" + compress_suffix);
+      topics.push_back(*it + "/trunk_recorder/status");
+    }
+    for (std::vector<std::string>::iterator it = unit_topics.begin(); it != unit_topics.end(); ++it)
+      topics.push_back(*it + "/+/+");
+
+    try
+    {
+      client->subscribe(mqtt::string_collection::create(topics), mqtt::iasync_client::qos_collection(topics.size(), 1));
+    }
+    catch (const mqtt::exception &exc)
+    {
+      std::cerr << "Unable to subscribe: " << exc.what() << std::endl;
+    }
+
+    nlohmann::ordered_json status_json = {{"status", "connected"}, {"instance_id", client_id}, {"client_id", client_id}};
+    publish(output_topic + "/status", status_json.dump(), true);
+
+    // A new session starts without the retained views; send them again on the next tick
+    std::lock_guard<std::mutex> lock(state_mutex);
+    published_views.clear();
+  }
+
+  // connection_lost()
+  //   Paho MQTT: Paho reconnects on its own.
+  void connection_lost(const std::string &cause) override
+  {
+    std::cerr << "Lost connection to broker: " << broker << " " << cause << std::endl;
+  }
+
+  // message_arrived()
+  //   Paho MQTT: Parse a message from an instance and update the merged state.
+  void message_arrived(mqtt::const_message_ptr msg) override
+  {
+    const std::string &topic = msg->get_topic();
+    std::string payload_str = msg->get_payload_str();
+    if (payload_str.empty())
+      return;
+
+    bool compressed = ((topic.size() > compress_suffix.size()) && (topic.compare(topic.size() - compress_suffix.size(), compress_suffix.size(), compress_suffix) == 0));
+    if (compressed)
+    {
+      std::string inflated;
+      if (!zlib_inflate(payload_str, inflated))
+      {
+        std::cerr << "Unable to inflate " << topic << std::endl;
+        return;
+      }
+      payload_str.swap(inflated);
+    }
+
+    nlohmann::ordered_json payload = nlohmann::ordered_json::parse(payload_str, nullptr, false);
+    if ((payload.is_discarded()) || (!payload.is_object()))
+      return;
+
+    // Skip the aggregator's own messages, in case the output topic is below a subscribed topic
+    std::string instance_id = payload.value("instance_id", "");
+    if ((instance_id == "") || (instance_id == client_id))
+      return;
+
+    std::lock_guard<std::mutex> lock(state_mutex);
+    Instance &instance = instances[instance_id];
+
+    // The plugin status has no type
+    if (payload.contains("status"))
+    {
+      instance.status = payload.value("status", "");
+      if (instance.status != "connected")
+      {
+        instance.calls = nlohmann::ordered_json::array();
+        instance.recorders = nlohmann::ordered_json::array();
+        instance.rates = nlohmann::ordered_json::array();
+      }
+      return;
+    }
+
+    std::string type = payload.value("type", "");
+    if (type == "calls_active")
+      instance.calls = get_array(payload, "calls");
+    else if (type == "recorders")
+      instance.recorders = get_array(payload, "recorders");
+    else if (type == "rates")
+      instance.rates = get_array(payload, "rates");
+    else if (type == "systems")
+      update_systems(instance, get_array(payload, "systems"));
+    else if ((type == "system_state") && payload.contains("system") && payload["system"].is_object())
+      update_systems(instance, nlohmann::ordered_json::array({payload["system"]}));
+    else if ((type == "call_start") || (type == "call_end"))
+      forward_call(instance_id, type, payload);
+    else if (payload.contains(type) && payload[type].is_object())
+      forward_unit(instance_id, type, payload);
+  }
+
+private:
+  struct Instance
+  {
+    std::string status = "connected";
+    std::map<std::string, std::string> systems; // sys_name -> system key
+    nlohmann::ordered_json calls = nlohmann::ordered_json::array();
+    nlohmann::ordered_json recorders = nlohmann::ordered_json::array();
+    nlohmann::ordered_json rates = nlohmann::ordered_json::array();
+  };
+
+  struct Merged_Call
+  {
+    nlohmann::ordered_json call;
+    std::string system;
+    long talkgroup;
+    long start_time;
+    bool recording;
+    std::vector<std::string> duplicates;
+  };
+
+  struct Recent_Event
+  {
+    std::string instance_id;
+    long event_time;
+    int64_t arrived_ms;
+  };
+
+  struct Recent_Arrival
+  {
+    std::string key;
+    int64_t arrived_ms;
+  };
+
+  struct Published_View
+  {
+    std::string data;    // the view as published
+    std::string compare; // without volatile fields
+    int64_t published_ms;
+  };
+
+  struct Unit_State
+  {
+    std::string type;
+    long talkgroup;
+    int64_t last_ms;
+  };
+
+  mqtt::async_client *client = nullptr;
+  mqtt::connect_options conn_opts;
+  std::mutex state_mutex;
+  std::map<std::string, Instance> instances;
+  std::unordered_map<std::string, std::vector<Recent_Event>> recent_events; // key -> events, oldest first
+  std::deque<Recent_Arrival> recent_arrivals;                                // every recent event, oldest first, for expiry
+  std::map<std::string, Unit_State> units;
+  std::map<std::string, Published_View> published_views;
+
+  // update_systems()
+  //   Key each of an instance's systems by "WACN-SYSID" when known, so the same network matches across instances.
+  //   The systems list is sent once at startup, often before the IDs are decoded; system_state follows them.
+  void update_systems(Instance &instance, const nlohmann::ordered_json &systems_json)
+  {
+    for (nlohmann::ordered_json::const_iterator it = systems_json.begin(); it != systems_json.end(); ++it)
+    {
+      std::string sys_name = it->value("sys_name", "");
+      std::string wacn = it->value("wacn", "0");
+      std::string sysid = it->value("sysid", "0");
+      if ((sys_name != "") && (wacn != "0") && (sysid != "0"))
+        instance.systems[sys_name] = wacn + "-" + sysid;
+    }
+  }
+
+  // get_system_key()
+  //   Return the key of an instance's system; systems without a WACN and system ID are unique to the instance.
+  std::string get_system_key(const std::string &instance_id, const nlohmann::ordered_json &data)
+  {
+    std::string sys_name = data.contains("sys_name") ? data.value("sys_name", "") : std::to_string(data.value("sys_num", -1));
+    Instance &instance = instances[instance_id];
+    std::map<std::string, std::string>::iterator it = instance.systems.find(sys_name);
+    if (it != instance.systems.end())
+      return it->second;
+
+    std::string key = instance_id + "-" + sys_name;
+    std::replace_if(key.begin(), key.end(), [](char c)
+                    { return ((c == '/') || (c == '+') || (c == '#')); }, '_');
+    return key;
+  }
+
+  // get_calls_json()
+  //   Merge the active calls of all instances.  A call on the same system and talkgroup that started within
+  //   duplicate_seconds of another is a duplicate; the copy being recorded is kept, and the other instances
+  //   are listed in "duplicates".
+  nlohmann::ordered_json get_calls_json()
+  {
+    std::vector<Merged_Call> merged;
+    for (std::map<std::string, Instance>::iterator inst = instances.begin(); inst != instances.end(); ++inst)
+    {
+      for (nlohmann::ordered_json::const_iterator it = inst->second.calls.begin(); it != inst->second.calls.end(); ++it)
+      {
+        if (!it->is_object())
+          continue;
+
+        Merged_Call call;
+        call.call = *it;
+        call.call["instance_id"] = inst->first;
+        call.system = get_system_key(inst->first, *it);
+        call.talkgroup = it->value("talkgroup", 0L);
+        call.start_time = get_start_time(*it);
+        call.recording = (it->value("call_state_type", "") == "RECORDING");
+
+        std::vector<Merged_Call>::iterator match = merged.begin();
+        for (; match != merged.end(); ++match)
+        {
+          if ((match->system == call.system) && (match->talkgroup == call.talkgroup) && (std::labs(match->start_time - call.start_time) <= duplicate_seconds))
+            break;
+        }
+
+        if (match == merged.end())
+          merged.push_back(call);
+        else if ((call.recording) && (!match->recording))
+        {
+          call.duplicates = match->duplicates;
+          call.duplicates.push_back(match->call.value("instance_id", ""));
+          *match = call;
+        }
+        else
+          match->duplicates.push_back(inst->first);
+      }
+    }
+
+    nlohmann::ordered_json calls_json = nlohmann::ordered_json::array();
+    for (std::vector<Merged_Call>::iterator it = merged.begin(); it != merged.end(); ++it)
+    {
+      it->call["system"] = it->system;
+      it->call["duplicates"] = it->duplicates;
+      calls_json.push_back(it->call);
+    }
+    return calls_json;
+  }
+
+  // get_start_time()
+  //   The call id ends in the start time (sys_num_talkgroup_start); fall back to start_time or elapsed.
+  static long get_start_time(const nlohmann::ordered_json &call)
+  {
+    if (call.contains("start_time"))
+      return call.value("start_time", 0L);
+
+    std::string id = call.value("id", "");
+    size_t pos = id.find_last_of('_');
+    if (pos != std::string::npos)
+      return std::atol(id.c_str() + pos + 1);
+    return time(NULL) - call.value("elapsed", 0L);
+  }
+
+  // get_instance_list_json()
+  //   Concatenate a list (recorders, rates) from all instances, adding instance_id to each entry.
+  nlohmann::ordered_json get_instance_list_json(nlohmann::ordered_json Instance::*list)
+  {
+    nlohmann::ordered_json list_json = nlohmann::ordered_json::array();
+    for (std::map<std::string, Instance>::iterator inst = instances.begin(); inst != instances.end(); ++inst)
+    {
+      const nlohmann::ordered_json &entries = inst->second.*list;
+      for (nlohmann::ordered_json::const_iterator it = entries.begin(); it != entries.end(); ++it)
+      {
+        if (!it->is_object())
+          continue;
+        nlohmann::ordered_json entry = *it;
+        entry["instance_id"] = inst->first;
+        if (entry.contains("sys_name"))
+          entry["system"] = get_system_key(inst->first, entry);
+        list_json.push_back(entry);
+      }
+    }
+    return list_json;
+  }
+
+  nlohmann::ordered_json get_instances_json()
+  {
+    nlohmann::ordered_json instances_json = nlohmann::ordered_json::array();
+    for (std::map<std::string, Instance>::iterator it = instances.begin(); it != instances.end(); ++it)
+    {
+      instances_json.push_back({{"instance_id", it->first},
+                                {"status", it->second.status},
+                                {"calls", it->second.calls.size()},
+                                {"recorders", it->second.recorders.size()}});
+    }
+    return instances_json;
+  }
+
+  // publish_view()
+  //   Publish a retained view if it differs from the last one sent.  Changes to volatile_fields of the view's
+  //   entries (call times, rates) only republish the view once refresh_seconds have passed.
+  void publish_view(const std::string &type, const std::string &name, const nlohmann::ordered_json &data, const std::vector<std::string> &volatile_fields)
+  {
+    nlohmann::ordered_json compare_json = data;
+    for (nlohmann::ordered_json::iterator entry = compare_json.begin(); entry != compare_json.end(); ++entry)
+    {
+      if (!entry->is_object())
+        continue;
+      for (std::vector<std::string>::const_iterator field = volatile_fields.begin(); field != volatile_fields.end(); ++field)
+        entry->erase(*field);
+    }
+    std::string compare_str = compare_json.dump();
+    std::string data_str = data.dump();
+
+    int64_t now_ms = steady_ms();
+    std::map<std::string, Published_View>::iterator it = published_views.find(type);
+    if ((it != published_views.end()) && (it->second.compare == compare_str))
+    {
+      if ((it->second.data == data_str) || ((now_ms - it->second.published_ms) < (refresh_seconds * 1000LL)))
+        return;
+    }
+
+    if (publish(output_topic + "/" + type, get_payload(type, name, data).dump(), true))
+      published_views[type] = {data_str, compare_str, now_ms};
+  }
+
+  // forward_call()
+  //   Republish call_start and call_end unless another instance already sent the same call.
+  void forward_call(const std::string &instance_id, const std::string &type, const nlohmann::ordered_json &payload)
+  {
+    if (!payload.contains("call") || !payload["call"].is_object())
+      return;
+
+    nlohmann::ordered_json call = payload["call"];
+    std::string system = get_system_key(instance_id, call);
+    std::string key = type + "|" + system + "|" + std::to_string(call.value("talkgroup", 0L));
+    if (is_duplicate(key, instance_id, get_start_time(call)))
+      return;
+
+    call["instance_id"] = instance_id;
+    call["system"] = system;
+    publish(output_topic + "/" + type, get_payload(type, "call", call).dump(), false);
+  }
+
+  // forward_unit()
+  //   Republish a unit event unless another instance already sent it, and update the unit's state.
+  void forward_unit(const std::string &instance_id, const std::string &type, const nlohmann::ordered_json &payload)
+  {
+    nlohmann::ordered_json event = payload[type];
+    std::string system = get_system_key(instance_id, event);
+    long unit = event.value("unit", 0L);
+    long talkgroup = event.value("talkgroup", 0L);
+    long event_time = time(NULL);
+    if (payload.contains("timestamp"))
+      event_time = payload["timestamp"].is_number() ? payload.value("timestamp", 0L) : std::atol(payload.value("timestamp", "0").c_str());
+
+    // An end message is one transmission (or call) and is matched by its start time, not when it was sent;
+    // the same unit may end several transmissions on a talkgroup within duplicate_seconds
+    if ((type == "end") && event.contains("start_time"))
+      event_time = event.value("start_time", event_time);
+
+    std::string key = type + "|" + system + "|" + std::to_string(unit) + "|" + std::to_string(talkgroup);
+    if (is_duplicate(key, instance_id, event_time))
+      return;
+
+    event["instance_id"] = instance_id;
+    event["system"] = system;
+    publish(output_topic + "/unit/" + type, get_payload(type, type, event).dump(), false);
+
+    // Unit state; "end" with one message per call has no unit
+    if (unit == 0)
+      return;
+
+    std::string unit_key = system + "/" + std::to_string(unit);
+    Unit_State &state = units[unit_key];
+    bool changed = ((state.type != type) || (state.talkgroup != talkgroup));
+    state.last_ms = steady_ms();
+    if (!changed)
+      return;
+
+    state.type = type;
+    state.talkgroup = talkgroup;
+    nlohmann::ordered_json unit_json = {
+        {"system", system},
+        {"sys_name", event.value("sys_name", "")},
+        {"unit", unit},
+        {"unit_alpha_tag", event.value("unit_alpha_tag", "")},
+        {"last_event", type},
+        {"talkgroup", talkgroup},
+        {"time", event_time},
+        {"instance_id", instance_id}};
+    publish(output_topic + "/units/" + unit_key, get_payload("unit_state", "unit", unit_json).dump(), true);
+  }
+
+  // is_duplicate()
+  //   True if another instance sent an event with the same key and an event_time within duplicate_seconds in the
+  //   last minute; otherwise remember this one.  Repeated events from one instance are never duplicates.
+  bool is_duplicate(const std::string &key, const std::string &instance_id, long event_time)
+  {
+    int64_t now_ms = steady_ms();
+    while ((!recent_arrivals.empty()) && ((now_ms - recent_arrivals.front().arrived_ms) > 60000))
+    {
+      // The oldest arrival is also the oldest event for its key
+      std::unordered_map<std::string, std::vector<Recent_Event>>::iterator expired = recent_events.find(recent_arrivals.front().key);
+      expired->second.erase(expired->second.begin());
+      if (expired->second.empty())
+        recent_events.erase(expired);
+      recent_arrivals.pop_front();
+    }
+
+    std::vector<Recent_Event> &events = recent_events[key];
+    for (std::vector<Recent_Event>::const_iterator it = events.begin(); it != events.end(); ++it)
+    {
+      if ((it->instance_id != instance_id) && (std::labs(it->event_time - event_time) <= duplicate_seconds))
+        return true;
+    }
+    events.push_back({instance_id, event_time, now_ms});
+    recent_arrivals.push_back({key, now_ms});
+    return false;
+  }
+
+  nlohmann::ordered_json get_payload(const std::string &type, const std::string &name, const nlohmann::ordered_json &data)
+  {
+    return {
+        {"type", type},
+        {name, data},
+        {"timestamp", time(NULL)},
+        {"instance_id", client_id}};
+  }
+
+  // publish()
+  //   Returns the delivery token, or nullptr if the message could not be queued.
+  mqtt::delivery_token_ptr publish(const std::string &topic, const std::string &payload, bool retained)
+  {
+    try
+    {
+      mqtt::message_ptr pubmsg = mqtt::message_ptr_builder()
+                                     .topic(topic)
+                                     .payload(payload)
+                                     .qos(1)
+                                     .retained(retained)
+                                     .finalize();
+      return client->publish(pubmsg);
+    }
+    catch (const mqtt::exception &exc)
+    {
+      std::cerr << exc.what() << std::endl;
+    }
+    return nullptr;
+  }
+
+  static nlohmann::ordered_json get_array(const nlohmann::ordered_json &payload, const std::string &name)
+  {
+    if (payload.contains(name) && payload[name].is_array())
+      return payload[name];
+    return nlohmann::ordered_json::array();
+  }
+
+  // zlib_inflate()
+  //   Decompress a payload from a compress_suffix topic.
+  static bool zlib_inflate(const std::string &input, std::string &output)
+  {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK)
+      return false;
+
+    stream.next_in = (Bytef *)input.data();
+    stream.avail_in = input.size();
+    char buffer[32768];
+    int ret;
+    output.clear();
+    do
+    {
+      stream.next_out = (Bytef *)buffer;
+      stream.avail_out = sizeof(buffer);
+      ret = inflate(&stream, Z_NO_FLUSH);
+      if ((ret != Z_OK) && (ret != Z_STREAM_END))
+        break;
+      output.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (ret != Z_STREAM_END);
+
+    inflateEnd(&stream);
+    return (ret == Z_STREAM_END);
+  }
+
+  static int64_t steady_ms()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+};
+
+static void usage()
+{
+  std::cerr << "Usage: mqtt_status_aggregator [-b broker] [-U username] [-P password] [-u unit_topic]... [-o output_topic]\n"
+               "                              [-i id] [-w duplicate_seconds] [-t unit_seconds] [-r refresh_seconds] [-z compress_suffix]\n"
+               "                              <topic> [<topic> ...]"
+            << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  Aggregator aggregator;
+  int opt;
+  while ((opt = getopt(argc, argv, "b:U:P:u:o:i:w:t:r:z:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'b':
+      aggregator.broker = optarg;
+      break;
+    case 'U':
+      aggregator.username = optarg;
+      break;
+    case 'P':
+      aggregator.password = optarg;
+      break;
+    case 'u':
+      aggregator.unit_topics.push_back(optarg);
+      break;
+    case 'o':
+      aggregator.output_topic = optarg;
+      break;
+    case 'i':
+      aggregator.client_id = optarg;
+      break;
+    case 'w':
+      aggregator.duplicate_seconds = std::max(0, atoi(optarg));
+      break;
+    case 't':
+      aggregator.unit_seconds = std::max(1, atoi(optarg));
+      break;
+    case 'r':
+      aggregator.refresh_seconds = std::max(1, atoi(optarg));
+      break;
+    case 'z':
+      aggregator.compress_suffix = optarg;
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  for (int i = optind; i < argc; i++)
+    aggregator.status_topics.push_back(argv[i]);
+  if (aggregator.status_topics.empty() && aggregator.unit_topics.empty())
+  {
+    usage();
+    return 1;
+  }
+
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  if (!aggregator.start())
+    return 1;
+
+  while (running)
+  {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    aggregator.tick();
+  }
+
+  aggregator.stop();
+  return 0;
+}
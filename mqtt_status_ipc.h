@@ -0,0 +1,290 @@
+// mqtt_status_ipc.h
+//   Shared memory ring of MQTT Status messages for consumers on the same host as trunk-recorder.
+//
+//   The plugin is the only writer.  Any number of readers map the ring read-only and follow the writer
+//   without locks; a reader that falls more than a ring behind detects the overrun and skips ahead.
+//
+//   Layout:  Ring_Header | data[capacity]
+//   Each record in data is a Record_Header, the topic, then the payload, padded to 8 bytes.  Records are
+//   never split across the end of the ring; the writer fills the remainder with a padding record (sequence 0)
+//   and starts again at offset 0.
+//
+//   Before copying a record (and any padding) the writer publishes reserve_pos, the end of the bytes it is about
+//   to overwrite, and afterwards write_pos.  A reader checks reserve_pos after copying a record, so a record
+//   the writer reached during the copy is reported as an overrun rather than returned torn.
+
+#ifndef MQTT_STATUS_IPC_H
+#define MQTT_STATUS_IPC_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mqtt_status_ipc
+{
+  const uint32_t ring_magic = 0x514d5254; // "TRMQ"
+  const uint32_t ring_version = 2;
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory ring requires lock-free 64 bit atomics");
+
+  struct Ring_Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;                // bytes in the data area
+    std::atomic<uint64_t> write_pos;  // bytes written since the ring was created; offset is write_pos % capacity
+    std::atomic<uint64_t> sequence;   // sequence number of the last message written
+    std::atomic<uint64_t> reserve_pos; // end of the record being written; equal to write_pos between writes
+    char reserved[24];
+  };
+
+  struct Record_Header
+  {
+    uint32_t length;         // record length including this header and padding; a multiple of 8
+    uint32_t topic_length;
+    uint32_t payload_length;
+    uint32_t reserved;
+    uint64_t sequence;       // 0 for padding records
+  };
+
+  inline uint64_t record_length(size_t topic_length, size_t payload_length)
+  {
+    return (sizeof(Record_Header) + topic_length + payload_length + 7) & ~(uint64_t)7;
+  }
+
+  // Ring_Writer
+  //   Creates (or replaces) the shared memory object and appends messages.  write() is not thread-safe;
+  //   callers with more than one producing thread must serialize it.
+  class Ring_Writer
+  {
+  public:
+    ~Ring_Writer() { close(); }
+
+    bool open(const std::string &name, uint64_t capacity)
+    {
+      close();
+      capacity &= ~(uint64_t)7;
+
+      // Start a new object; readers still mapping a previous ring must open the name again
+      shm_unlink(name.c_str());
+      int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_EXCL, 0644);
+      if (fd < 0)
+        return false;
+
+      map_size = sizeof(Ring_Header) + capacity;
+      if (ftruncate(fd, map_size) != 0)
+      {
+        ::close(fd);
+        return false;
+      }
+      void *addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (addr == MAP_FAILED)
+        return false;
+
+      header = static_cast<Ring_Header *>(addr);
+      data = static_cast<char *>(addr) + sizeof(Ring_Header);
+      header->capacity = capacity;
+      header->write_pos.store(0, std::memory_order_relaxed);
+      header->sequence.store(0, std::memory_order_relaxed);
+      header->reserve_pos.store(0, std::memory_order_relaxed);
+      header->version = ring_version;
+      std::atomic_thread_fence(std::memory_order_release);
+      header->magic = ring_magic;
+      shm_name = name;
+      return true;
+    }
+
+    void close()
+    {
+      if (header == nullptr)
+        return;
+      munmap(header, map_size);
+      shm_unlink(shm_name.c_str());
+      header = nullptr;
+      data = nullptr;
+    }
+
+    bool is_open() const { return (header != nullptr); }
+
+    // write()
+    //   Append a message and return its sequence number, or 0 if it does not fit in half of the ring.
+    uint64_t write(const std::string &topic, const std::string &payload)
+    {
+      uint64_t capacity = header->capacity;
+      uint64_t length = record_length(topic.size(), payload.size());
+      if (length > capacity / 2)
+        return 0;
+
+      uint64_t pos = header->write_pos.load(std::memory_order_relaxed);
+      uint64_t offset = pos % capacity;
+      uint64_t end = pos + length;
+      if ((capacity - offset) < length)
+        end += capacity - offset;
+
+      // Readers that copy any of the bytes written below will see the reservation
+      header->reserve_pos.store(end, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      // Pad out the end of the ring rather than split the record
+      if ((capacity - offset) < length)
+      {
+        if ((capacity - offset) >= sizeof(Record_Header))
+        {
+          Record_Header pad = {(uint32_t)(capacity - offset), 0, 0, 0, 0};
+          memcpy(data + offset, &pad, sizeof(pad));
+        }
+        pos += capacity - offset;
+        offset = 0;
+      }
+
+      uint64_t sequence = header->sequence.load(std::memory_order_relaxed) + 1;
+      Record_Header record = {(uint32_t)length, (uint32_t)topic.size(), (uint32_t)payload.size(), 0, sequence};
+      memcpy(data + offset, &record, sizeof(record));
+      memcpy(data + offset + sizeof(record), topic.data(), topic.size());
+      memcpy(data + offset + sizeof(record) + topic.size(), payload.data(), payload.size());
+
+      header->sequence.store(sequence, std::memory_order_relaxed);
+      header->write_pos.store(end, std::memory_order_release);
+      return sequence;
+    }
+
+  private:
+    Ring_Header *header = nullptr;
+    char *data = nullptr;
+    size_t map_size = 0;
+    std::string shm_name;
+  };
+
+  // Ring_Reader
+  //   Maps an existing ring read-only and returns messages in order, starting with the next one written.
+  class Ring_Reader
+  {
+  public:
+    enum Result
+    {
+      MESSAGE,  // topic, payload, and sequence were filled in
+      EMPTY,    // no new message yet
+      OVERRUN   // the writer lapped the reader; lost() was increased and reading resumes at the newest message
+    };
+
+    ~Ring_Reader() { close(); }
+
+    bool open(const std::string &name)
+    {
+      close();
+      int fd = shm_open(name.c_str(), O_RDONLY, 0);
+      if (fd < 0)
+        return false;
+
+      struct stat st;
+      if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(Ring_Header)))
+      {
+        ::close(fd);
+        return false;
+      }
+      map_size = st.st_size;
+      void *addr = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (addr == MAP_FAILED)
+        return false;
+
+      header = static_cast<const Ring_Header *>(addr);
+      data = static_cast<const char *>(addr) + sizeof(Ring_Header);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ((header->magic != ring_magic) || (header->version != ring_version) || ((sizeof(Ring_Header) + header->capacity) > map_size))
+      {
+        close();
+        return false;
+      }
+      read_pos = header->write_pos.load(std::memory_order_acquire);
+      last_sequence = header->sequence.load(std::memory_order_relaxed);
+      lost_count = 0;
+      return true;
+    }
+
+    void close()
+    {
+      if (header == nullptr)
+        return;
+      munmap(const_cast<Ring_Header *>(header), map_size);
+      header = nullptr;
+      data = nullptr;
+    }
+
+    bool is_open() const { return (header != nullptr); }
+
+    // lost()
+    //   Messages overwritten before this reader could copy them.
+    uint64_t lost() const { return lost_count; }
+
+    Result read(std::string &topic, std::string &payload, uint64_t &sequence)
+    {
+      uint64_t capacity = header->capacity;
+      while (true)
+      {
+        uint64_t write_pos = header->write_pos.load(std::memory_order_acquire);
+        if (read_pos == write_pos)
+          return EMPTY;
+        if ((write_pos - read_pos) > capacity)
+          return overrun(write_pos);
+
+        uint64_t offset = read_pos % capacity;
+        if ((capacity - offset) < sizeof(Record_Header))
+        {
+          read_pos += capacity - offset;
+          continue;
+        }
+
+        Record_Header record;
+        memcpy(&record, data + offset, sizeof(record));
+        bool valid = ((record.length >= sizeof(Record_Header)) && (record.length <= capacity - offset) &&
+                      ((sizeof(Record_Header) + (uint64_t)record.topic_length + record.payload_length) <= record.length));
+        if (valid && (record.sequence != 0))
+        {
+          topic.assign(data + offset + sizeof(record), record.topic_length);
+          payload.assign(data + offset + sizeof(record) + record.topic_length, record.payload_length);
+        }
+
+        // The record is only good if the writer did not start overwriting it while it was being copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((header->reserve_pos.load(std::memory_order_relaxed) - read_pos) > capacity)
+          return overrun(header->write_pos.load(std::memory_order_acquire));
+        if (!valid)
+          return overrun(write_pos);
+
+        read_pos += record.length;
+        if (record.sequence == 0)
+          continue;
+
+        sequence = record.sequence;
+        last_sequence = sequence;
+        return MESSAGE;
+      }
+    }
+
+  private:
+    Result overrun(uint64_t write_pos)
+    {
+      uint64_t sequence = header->sequence.load(std::memory_order_relaxed);
+      lost_count += sequence - last_sequence;
+      last_sequence = sequence;
+      read_pos = write_pos;
+      return OVERRUN;
+    }
+
+    const Ring_Header *header = nullptr;
+    const char *data = nullptr;
+    size_t map_size = 0;
+    uint64_t read_pos = 0;
+    uint64_t last_sequence = 0;
+    uint64_t lost_count = 0;
+  };
+}
+
+#endif
@@ -0,0 +1,61 @@
+// MQTT Status IPC Reader
+//   Example consumer of the MQTT Status plugin's shared memory ring.  Prints each message as
+//   "sequence topic payload", one per line, and reports messages lost to overruns on stderr.
+//
+//   Usage: mqtt_status_ipc_reader [ipc_shm_name]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "mqtt_status_ipc.h"
+
+int main(int argc, char **argv)
+{
+  std::string shm_name = (argc > 1) ? argv[1] : "/trunk-recorder";
+  if (shm_name.front() != '/')
+    shm_name = "/" + shm_name;
+
+  mqtt_status_ipc::Ring_Reader reader;
+  std::string topic;
+  std::string payload;
+  uint64_t sequence;
+  int idle_ms = 0;
+
+  while (true)
+  {
+    // Wait for the plugin to create the ring, and open it again if trunk-recorder restarts
+    if (!reader.is_open())
+    {
+      if (!reader.open(shm_name))
+      {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        continue;
+      }
+      std::cerr << "Opened " << shm_name << std::endl;
+    }
+
+    switch (reader.read(topic, payload, sequence))
+    {
+    case mqtt_status_ipc::Ring_Reader::MESSAGE:
+      std::cout << sequence << " " << topic << " " << payload << "\n";
+      idle_ms = 0;
+      break;
+
+    case mqtt_status_ipc::Ring_Reader::OVERRUN:
+      std::cerr << "Overrun, " << reader.lost() << " messages lost" << std::endl;
+      break;
+
+    case mqtt_status_ipc::Ring_Reader::EMPTY:
+      std::cout.flush();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      if (++idle_ms >= 10000)
+      {
+        reader.close();
+        idle_ms = 0;
+      }
+      break;
+    }
+  }
+  return 0;
+}
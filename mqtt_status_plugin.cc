@@ -12,11 +12,28 @@
 #include <map>
 #include <cstring>
 #include <regex>
+#include <algorithm>
+#include <charconv>
+#include <memory>
+#include <cmath>
+#include <bitset>
+#include <set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <random>
+#include <climits>
+#include <cerrno>
+#include <zlib.h>
 #include <mqtt/client.h>
 #include <trunk-recorder/source.h>
 #include <json.hpp>
 // #include <trunk-recorder/json.hpp>
 #include <trunk-recorder/plugin_manager/plugin_api.h>
+#include "mqtt_status_ipc.h"
 #include <boost/archive/iterators/base64_from_binary.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp> //time_formatters.hpp>
@@ -27,15 +44,145 @@
 #include <boost/log/sinks/sync_frontend.hpp>
 #include <boost/log/sinks/text_ostream_backend.hpp>
 #include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/join.hpp>
 
 using namespace std;
 namespace logging = boost::log;
 
 class Mqtt_Status : public Plugin_Api, public virtual mqtt::callback
 {
+  // Payload test and benchmark (test/payload_test.cc)
+  friend class Mqtt_Status_Test;
+
   // Paho MQTT
-  mqtt::async_client *mqtt_client;
-  bool mqtt_connected = false;
+  mqtt::async_client *mqtt_client = nullptr;
+  std::atomic<bool> mqtt_connected{false};
+  mqtt::connect_options mqtt_conn_opts;
+  mqtt::token_ptr mqtt_conn_token;
+  std::string mqtt_status_topic;
+  std::string mqtt_status_connected;
+  std::string mqtt_status_disconnected;
+  int reconnect_min;
+  int reconnect_max;
+  std::atomic<int64_t> reconnect_time_ms{0};
+  std::atomic<int> reconnect_backoff{0};
+  std::mt19937 reconnect_rng{std::random_device{}()};
+
+  // Shutdown; once stop() begins, new trunk-recorder events are ignored while the queues drain
+  std::atomic<bool> stopping{false};
+  int shutdown_timeout;
+
+  // Retained messages (topic -> payload), republished on each connection to the broker
+  std::map<std::string, std::string> retained_cache;
+  std::set<std::string> retained_cleared;   // cleared while disconnected; emptied at the broker on the next connection
+  std::mutex retained_mutex;
+
+  // Field projection
+  //   Each message type may list the fields to send; the list is compiled to a bitmask of the field's index
+  //   in its builder's field table below.  Types without a list send every field.
+  enum Call_Field
+  {
+    CALL_ID, CALL_CALL_NUM, CALL_SYS_NUM, CALL_SYS_NAME, CALL_FREQ, CALL_UNIT, CALL_UNIT_ALPHA_TAG,
+    CALL_TALKGROUP, CALL_TALKGROUP_ALPHA_TAG, CALL_TALKGROUP_DESCRIPTION, CALL_TALKGROUP_GROUP, CALL_TALKGROUP_TAG, CALL_TALKGROUP_PATCHES,
+    CALL_ELAPSED, CALL_LENGTH, CALL_CALL_STATE, CALL_CALL_STATE_TYPE, CALL_MON_STATE, CALL_MON_STATE_TYPE, CALL_AUDIO_TYPE,
+    CALL_PHASE2_TDMA, CALL_TDMA_SLOT, CALL_ANALOG, CALL_REC_NUM, CALL_SRC_NUM, CALL_REC_STATE, CALL_REC_STATE_TYPE,
+    CALL_CONVENTIONAL, CALL_ENCRYPTED, CALL_EMERGENCY, CALL_START_TIME, CALL_STOP_TIME, CALL_PROCESS_CALL_TIME,
+    CALL_ERROR_COUNT, CALL_SPIKE_COUNT, CALL_RETRY_ATTEMPT, CALL_FREQ_ERROR, CALL_SIGNAL, CALL_NOISE, CALL_CALL_FILENAME
+  };
+  enum Recorder_Field
+  {
+    REC_ID, REC_SRC_NUM, REC_REC_NUM, REC_TYPE, REC_DURATION, REC_FREQ, REC_COUNT, REC_REC_STATE, REC_REC_STATE_TYPE, REC_SQUELCHED
+  };
+  enum System_Field
+  {
+    SYS_SYS_NUM, SYS_SYS_NAME, SYS_TYPE, SYS_SYSID, SYS_WACN, SYS_NAC, SYS_RFSS, SYS_SITE_ID
+  };
+  enum Unit_Field
+  {
+    UNIT_SYS_NUM, UNIT_SYS_NAME, UNIT_UNIT, UNIT_UNIT_ALPHA_TAG,
+    UNIT_TALKGROUP, UNIT_TALKGROUP_ALPHA_TAG, UNIT_TALKGROUP_DESCRIPTION, UNIT_TALKGROUP_GROUP, UNIT_TALKGROUP_TAG, UNIT_TALKGROUP_PATCHES,
+    UNIT_CALL_NUM, UNIT_FREQ, UNIT_POSITION, UNIT_LENGTH, UNIT_EMERGENCY, UNIT_ENCRYPTED, UNIT_START_TIME, UNIT_STOP_TIME,
+    UNIT_ERROR_COUNT, UNIT_SPIKE_COUNT, UNIT_SAMPLE_COUNT, UNIT_TRANSMISSION_FILENAME
+  };
+  const std::vector<std::string> call_fields = {
+      "id", "call_num", "sys_num", "sys_name", "freq", "unit", "unit_alpha_tag",
+      "talkgroup", "talkgroup_alpha_tag", "talkgroup_description", "talkgroup_group", "talkgroup_tag", "talkgroup_patches",
+      "elapsed", "length", "call_state", "call_state_type", "mon_state", "mon_state_type", "audio_type",
+      "phase2_tdma", "tdma_slot", "analog", "rec_num", "src_num", "rec_state", "rec_state_type",
+      "conventional", "encrypted", "emergency", "start_time", "stop_time", "process_call_time",
+      "error_count", "spike_count", "retry_attempt", "freq_error", "signal", "noise", "call_filename"};
+  const std::vector<std::string> recorder_fields = {
+      "id", "src_num", "rec_num", "type", "duration", "freq", "count", "rec_state", "rec_state_type", "squelched"};
+  const std::vector<std::string> system_fields = {
+      "sys_num", "sys_name", "type", "sysid", "wacn", "nac", "rfss", "site_id"};
+  const std::vector<std::string> unit_fields = {
+      "sys_num", "sys_name", "unit", "unit_alpha_tag",
+      "talkgroup", "talkgroup_alpha_tag", "talkgroup_description", "talkgroup_group", "talkgroup_tag", "talkgroup_patches",
+      "call_num", "freq", "position", "length", "emergency", "encrypted", "start_time", "stop_time",
+      "error_count", "spike_count", "sample_count", "transmission_filename"};
+  std::map<std::string, uint64_t> field_masks;
+  static const uint64_t all_fields = ~0ULL;
+
+  // Topic templates
+  //   "{topic}/{sys_name}/{talkgroup}/{type}" is compiled once to literal and placeholder segments, then
+  //   rendered for each message.
+  enum Topic_Field
+  {
+    TOPIC_LITERAL, TOPIC_BASE, TOPIC_UNIT_BASE, TOPIC_MESSAGE_BASE, TOPIC_INSTANCE_ID,
+    TOPIC_SYS_NAME, TOPIC_SYS_NUM, TOPIC_TALKGROUP, TOPIC_UNIT, TOPIC_TYPE
+  };
+  struct Topic_Segment
+  {
+    Topic_Field field;
+    std::string literal;
+  };
+  struct Topic_Values
+  {
+    System *sys;
+    long talkgroup;
+    long unit;
+  };
+  const std::map<std::string, Topic_Field> topic_placeholders = {
+      {"topic", TOPIC_BASE},
+      {"unit_topic", TOPIC_UNIT_BASE},
+      {"message_topic", TOPIC_MESSAGE_BASE},
+      {"instance_id", TOPIC_INSTANCE_ID},
+      {"sys_name", TOPIC_SYS_NAME},
+      {"sys_num", TOPIC_SYS_NUM},
+      {"talkgroup", TOPIC_TALKGROUP},
+      {"unit", TOPIC_UNIT},
+      {"type", TOPIC_TYPE}};
+  std::map<std::string, std::vector<Topic_Segment>> topic_templates;
+  static constexpr const char *topic_empty_value = "none";
+
+  // Send shards
+  //   With serialize_threads > 0, messages about a system (call, unit, and trunking messages) are dumped,
+  //   compressed, and published by one of serialize_threads workers chosen by sys_num.  Unit and trunking
+  //   messages are also built there, from a Json_Builder.  Messages for a system stay in order; messages for
+  //   different systems may not.
+  typedef std::function<nlohmann::ordered_json()> Json_Builder;
+  struct Send_Job
+  {
+    nlohmann::ordered_json data;
+    Json_Builder build; // builds data on the shard, if set
+    std::string name;
+    std::string type;
+    std::string topic;
+    int64_t event_ms;
+  };
+  struct Send_Shard
+  {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Send_Job> queue;
+    std::thread thread;
+    bool running = false;
+  };
+  std::vector<std::unique_ptr<Send_Shard>> send_shards;
+  int serialize_threads;
+  const size_t send_shard_max = 10000;
+  std::atomic<uint64_t> send_shard_dropped{0};
 
   // Trunk-Recorder
   Config *tr_config;
@@ -55,12 +202,81 @@ class Mqtt_Status : public Plugin_Api, public virtual mqtt::callback
   std::string topic_message;
   std::string topic_console;
   bool unit_enabled = false;
+  bool unit_end_batch = false;
   bool message_enabled = false;
   bool console_enabled = false;
+  bool message_stats_enabled = false;
   bool mqtt_audio = false;
   std::string mqtt_audio_type;
+  int mqtt_audio_bitrate;
+  std::string opus_dir;
+
+  // Calls waiting to be encoded to Opus and sent by the background audio thread (call info, wav copy)
+  std::deque<std::pair<Call_Data_t, std::string>> opus_queue;
+  std::mutex opus_mutex;
+  std::condition_variable opus_cv;
+  std::thread opus_thread;
+  bool opus_running = false;
+  bool opus_stopped_logged = false;
+  const size_t opus_queue_max = 100;
+  bool archive_enabled = false;
+  std::string archive_dir;
+  int archive_segment_seconds;
+  int archive_block_size;
+  std::set<std::string> archive_types;
+  std::string ipc_shm_name;
+  int ipc_shm_size;
+  mqtt_status_ipc::Ring_Writer ipc_ring;
+  std::mutex ipc_mutex;
+  std::set<std::string> compress_types;
+  int compress_threshold;
+  int compress_level;
+  std::string compress_suffix;
+  int metrics_interval;
+  time_t metrics_time = time(NULL);
   std::string log_prefix;
-  time_t call_resend_time = time(NULL);
+  bool calls_resend = true;
+  bool entity_topics = false;
+
+  // Retained per-entity topics (topic -> hash of the last data sent)
+  //   call_end() clears a call's topic from trunk-recorder's call threads while send_call_entities() walks
+  //   call_entities on the main thread, so call_entities is only used under call_entities_mutex.
+  std::mutex call_entities_mutex;
+  std::map<std::string, size_t> call_entities;
+  std::map<std::string, size_t> recorder_entities;
+  std::map<std::string, size_t> system_entities;
+  std::map<std::string, size_t> source_entities;
+  std::map<std::string, size_t> index_entity;
+  bool systems_dirty = false;
+
+  // Talkgroup patches by sys_num, updated from trunk-recorder once per setup_config()
+  //   call_end() reads patch strings from trunk-recorder's call threads while trunk_message() and update_patches()
+  //   change the tables on the main thread, so patch_tables is only used under patch_mutex.
+  struct Patch_Table
+  {
+    std::map<unsigned long, std::vector<unsigned long>> members; // talkgroup -> talkgroups patched with it
+    std::map<unsigned long, std::string> patch_str;              // talkgroup -> "talkgroup_patches" string
+    std::set<unsigned long> touched;                             // talkgroups in PATCH_ADD/PATCH_DELETE messages since the last update
+  };
+  std::vector<Patch_Table> patch_tables;
+  std::mutex patch_mutex;
+
+  // Unit message lookups
+  //   The unit alias, talkgroup metadata, and patches of a unit message are copied in the trunk-recorder hook,
+  //   since trunk-recorder and update_patches() may change them while a send shard builds the message.
+  struct Talkgroup_Lookup
+  {
+    std::string alpha_tag;
+    std::string description;
+    std::string group;
+    std::string tag;
+    std::string patches;
+  };
+  struct Unit_Lookup
+  {
+    std::string unit_alpha_tag;
+    Talkgroup_Lookup talkgroup;
+  };
 
   std::map<short, std::vector<std::string>> opcode_type = {
       {0x00, {"GRP_V_CH_GRANT", "Group Voice Channel Grant"}},
@@ -169,6 +385,533 @@ class Mqtt_Status : public Plugin_Api, public virtual mqtt::callback
       {7, "SUPERSEDED"}};
 
 private:
+  // Per-system trunk message filter, compiled from the "message_filter" config at startup.
+  //   mask          <- opcodes that may be published
+  //   sample_n      <- publish 1-in-N messages of an opcode (0/1 = every message)
+  //   min_interval  <- minimum seconds between messages of an opcode (0 = no limit)
+  struct Opcode_Filter
+  {
+    std::bitset<256> mask;
+    uint32_t sample_n[256];
+    uint32_t sample_count[256];
+    time_t min_interval[256];
+    time_t last_sent[256];
+
+    Opcode_Filter()
+    {
+      mask.set();
+      std::fill(std::begin(sample_n), std::end(sample_n), 1);
+      std::fill(std::begin(sample_count), std::end(sample_count), 0);
+      std::fill(std::begin(min_interval), std::end(min_interval), 0);
+      std::fill(std::begin(last_sent), std::end(last_sent), 0);
+    }
+  };
+
+  // Per-system trunk message counters, accumulated by trunk_message() and published with system_rates().
+  //   message_type[16] counts UNKNOWN (99) and any other unlisted type.
+  struct Message_Stats
+  {
+    uint32_t total = 0;
+    uint32_t message_type[17] = {};
+    uint32_t opcode[256] = {};
+  };
+
+  std::vector<Message_Stats> message_stats;
+
+  // Per-system decode rate history for rolling 1/5/15 minute rollups.
+  //   Samples are kept in a fixed ring; each window keeps a running sum and monotonic min/max queues
+  //   of sample numbers so every new sample is O(1) amortized.
+  struct Rate_Window
+  {
+    int64_t span_ms = 0;
+    uint64_t first = 0;
+    double sum = 0;
+    std::deque<uint64_t> min_queue;
+    std::deque<uint64_t> max_queue;
+  };
+
+  struct Rate_History
+  {
+    static const int capacity = 512;
+    static const int changes_capacity = 64;
+    int64_t sample_ms[capacity];
+    float sample_rate[capacity];
+    uint64_t count = 0;
+    Rate_Window windows[3];
+
+    double control_channel = 0;
+    int64_t change_ms[changes_capacity];
+    uint64_t change_count = 0;
+    time_t last_change = 0;
+
+    Rate_History()
+    {
+      windows[0].span_ms = 60 * 1000;
+      windows[1].span_ms = 300 * 1000;
+      windows[2].span_ms = 900 * 1000;
+    }
+  };
+
+  std::vector<Rate_History> rate_history;
+
+  // Recorder utilization, sampled every setup_config() cycle and summarized per source and recorder type
+  struct Recorder_Usage
+  {
+    double state_seconds[9] = {};
+    double in_use_seconds = 0;
+    int recorders = 0;
+    int peak_in_use = 0;
+  };
+
+  std::map<int, Recorder_Usage> source_usage;
+  std::map<std::string, Recorder_Usage> type_usage;
+  std::vector<uint32_t> missed_calls;
+  int recorder_stats_interval;
+  time_t recorder_stats_time = time(NULL);
+  int64_t recorder_sample_ms = 0;
+  int rate_rollup_interval;
+  time_t rate_rollup_time = time(NULL);
+
+  // Talkgroup and unit activity, counted from call_end() and published every activity_interval
+  //   Activity_Table is an open-addressing hash table with linear probing and a fixed number of entries, so memory
+  //   is bounded on systems with many radio ids; entries past the limit are counted as overflow.  Keys are
+  //   (sys_num + 1) << 32 | id, leaving 0 to mark an empty slot.
+  template <typename Value>
+  class Activity_Table
+  {
+  public:
+    struct Slot
+    {
+      uint64_t key;
+      Value value;
+    };
+
+    void init(size_t max_entries)
+    {
+      limit = std::max((size_t)1, max_entries);
+      size_t capacity = 16;
+      while (capacity < limit + (limit / 3))
+        capacity <<= 1;
+      slots.assign(capacity, Slot());
+      mask = capacity - 1;
+      count = 0;
+      overflow = 0;
+    }
+
+    static uint64_t make_key(int sys_num, uint32_t id)
+    {
+      return ((uint64_t)(sys_num + 1) << 32) | id;
+    }
+
+    // find_or_insert()
+    //   Return the value for a key, adding it if there is room; nullptr if the table is full.
+    Value *find_or_insert(uint64_t key)
+    {
+      size_t index = mix(key) & mask;
+      while (slots[index].key != 0)
+      {
+        if (slots[index].key == key)
+          return &slots[index].value;
+        index = (index + 1) & mask;
+      }
+      if (count >= limit)
+      {
+        overflow++;
+        return nullptr;
+      }
+      slots[index].key = key;
+      slots[index].value = Value();
+      count++;
+      return &slots[index].value;
+    }
+
+    void clear()
+    {
+      for (typename std::vector<Slot>::iterator it = slots.begin(); it != slots.end(); ++it)
+        it->key = 0;
+      count = 0;
+      overflow = 0;
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    uint64_t overflow = 0;
+
+  private:
+    static uint64_t mix(uint64_t key)
+    {
+      key ^= key >> 33;
+      key *= 0xff51afd7ed558ccdULL;
+      key ^= key >> 33;
+      return key;
+    }
+
+    size_t limit = 1;
+    size_t mask = 0;
+  };
+
+  // Unit_Sketch
+  //   HyperLogLog estimate of the unique units heard on a talkgroup, in 128 bytes (about 9% error).
+  struct Unit_Sketch
+  {
+    static const int precision = 7;
+    static const int registers = 1 << precision;
+    uint8_t rank[registers] = {};
+
+    void add(uint64_t id)
+    {
+      // splitmix64 finalizer, so sequential radio ids are spread across registers
+      uint64_t hash = id + 0x9e3779b97f4a7c15ULL;
+      hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+      hash ^= hash >> 31;
+
+      int index = hash >> (64 - precision);
+      uint64_t rest = (hash << precision) | (1ULL << (precision - 1));
+      uint8_t value = __builtin_clzll(rest) + 1;
+      if (value > rank[index])
+        rank[index] = value;
+    }
+
+    long estimate() const
+    {
+      double sum = 0;
+      int zeros = 0;
+      for (int i = 0; i < registers; i++)
+      {
+        sum += std::ldexp(1.0, -rank[i]);
+        if (rank[i] == 0)
+          zeros++;
+      }
+      double alpha = 0.7213 / (1 + 1.079 / registers);
+      double estimate = alpha * registers * registers / sum;
+      if ((estimate <= 2.5 * registers) && (zeros > 0))
+        estimate = registers * std::log((double)registers / zeros);
+      return std::lround(estimate);
+    }
+  };
+
+  struct Talkgroup_Activity
+  {
+    uint32_t calls = 0;
+    uint32_t transmissions = 0;
+    uint32_t emergencies = 0;
+    uint32_t encrypted = 0;
+    double airtime = 0;
+    Unit_Sketch units;
+  };
+
+  struct Unit_Activity
+  {
+    uint32_t calls = 0;
+    uint32_t transmissions = 0;
+    uint32_t emergencies = 0;
+    double airtime = 0;
+    long last_call_num = -1;
+  };
+
+  // call_end() counts into the current tables from trunk-recorder's call threads; send_activity() swaps them
+  // with the empty last tables under activity_mutex, then sends and clears the last tables.
+  std::mutex activity_mutex;
+  Activity_Table<Talkgroup_Activity> talkgroup_activity;
+  Activity_Table<Unit_Activity> unit_activity;
+  Activity_Table<Talkgroup_Activity> talkgroup_activity_last;
+  Activity_Table<Unit_Activity> unit_activity_last;
+  int activity_interval;
+  int activity_top;
+  time_t activity_time = time(NULL);
+
+  Opcode_Filter message_filter_default;
+  std::map<std::string, Opcode_Filter> message_filter_named;
+  std::vector<Opcode_Filter> message_filters;
+
+  // Plugin metrics; updated from any thread, published on topic/trunk_recorder/metrics
+  struct Plugin_Metrics
+  {
+    std::atomic<uint64_t> compressed_messages{0};
+    std::atomic<uint64_t> compress_bytes_in{0};
+    std::atomic<uint64_t> compress_bytes_out{0};
+    std::atomic<uint64_t> compress_cpu_ns{0};
+  };
+
+  Plugin_Metrics metrics;
+
+  // Broker delivery tracking for QoS 1/2 messages, keyed by the published message
+  //   Ack latency buckets (ms): 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, +Inf
+  struct Delivery_Stats
+  {
+    uint64_t count = 0;
+    uint64_t ack_buckets[13] = {};
+    double ack_ms_sum = 0;
+    double ack_ms_max = 0;
+    double event_ms_sum = 0;
+    double event_ms_max = 0;
+  };
+
+  struct In_Flight
+  {
+    std::string type;
+    int64_t publish_ms;
+    int64_t event_ms;
+  };
+
+  const int delivery_buckets[12] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+  std::map<const mqtt::message *, In_Flight> in_flight;
+  std::map<std::string, Delivery_Stats> delivery_stats;
+  uint64_t delivery_lost = 0;
+  std::mutex delivery_mutex;
+  bool timestamp_ms = false;
+  double ack_ms_average = 0;
+
+  // Overload control
+  //   Levels 1-3 are entered when pending messages or ack latency cross a threshold, and shed message
+  //   types in priority tiers.  A level is left after recover_seconds below half of its thresholds.
+  bool overload_enabled = false;
+  int overload_pending[3];
+  int overload_latency_ms[3];
+  int overload_recover_seconds;
+  std::atomic<int> overload_level{0};
+  std::atomic<uint64_t> overload_publish_errors{0};
+  std::atomic<uint64_t> overload_dropped[4];
+  int64_t overload_check_ms = 0;
+  int64_t overload_recover_ms = 0;
+
+  // Publish_Listener
+  //   Counts the messages handed to Paho that it has not finished: written to the socket at QoS 0, or
+  //   acknowledged at QoS 1/2.  Paho's own pending delivery tokens are only kept at QoS 1/2.
+  class Publish_Listener : public virtual mqtt::iaction_listener
+  {
+  public:
+    std::atomic<int64_t> outstanding{0};
+
+    void on_failure(const mqtt::token &tok) override { outstanding--; }
+    void on_success(const mqtt::token &tok) override { outstanding--; }
+  };
+  Publish_Listener publish_listener;
+  std::map<std::string, int> overload_tiers = {
+      {"console", 1},
+      {"message", 1},
+      {"message_stats", 1},
+      {"location", 2},
+      {"ackresp", 2},
+      {"calls_active", 3},
+      {"recorders", 3},
+      {"recorder", 3},
+      {"rates", 3},
+      {"recorder_stats", 3}};
+
+  // Periodic publisher schedule
+  //   Each check hashes the payload; unchanged payloads are skipped until heartbeat_ms has passed,
+  //   and the check interval doubles from min_ms up to max_ms while nothing changes.
+  struct Publish_Schedule
+  {
+    int64_t min_ms = 1000;
+    int64_t max_ms = 1000;
+    int64_t heartbeat_ms = 1000;
+    int64_t interval_ms = 1000;
+    int64_t next_ms = 0;
+    int64_t last_publish_ms = 0;
+    uint64_t last_hash = 0;
+  };
+
+  Publish_Schedule calls_schedule;
+  Publish_Schedule recorders_schedule;
+  Publish_Schedule rates_schedule;
+
+  // Local event archive
+  //   Appends MQTT messages to rotating, block-compressed NDJSON files on a background thread.
+  //   Each block is a complete gzip member, so a segment can be read with zcat.  A .idx file
+  //   next to each segment lists the offset, length, time range, and message count of each block.
+  class Archive_Writer
+  {
+  public:
+    ~Archive_Writer() { stop(); }
+
+    void start(const std::string &dir, int segment_seconds, size_t block_size, const std::string &prefix)
+    {
+      archive_dir = dir;
+      segment_seconds_ = segment_seconds;
+      block_size_ = block_size;
+      log_prefix = prefix;
+
+      boost::system::error_code ec;
+      boost::filesystem::create_directories(archive_dir, ec);
+      if (ec)
+      {
+        BOOST_LOG_TRIVIAL(error) << log_prefix << "Unable to create archive directory " << archive_dir << ": " << ec.message();
+        return;
+      }
+
+      running = true;
+      writer_thread = std::thread(&Archive_Writer::run, this);
+    }
+
+    // write()
+    //   Queue one message for the archive; called from any thread.
+    void write(const std::string &topic, const std::string &payload)
+    {
+      std::string line = "{\"topic\":" + json(topic).dump() + ",\"msg\":" + payload + "}\n";
+
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      if (!running)
+        return;
+      if (queued_bytes + line.size() > max_queued_bytes)
+      {
+        dropped++;
+        return;
+      }
+      queued_bytes += line.size();
+      queue.emplace_back(time(NULL), std::move(line));
+      queue_cv.notify_one();
+    }
+
+    // stop()
+    //   Flush any queued messages, close the current segment, and join the writer thread.
+    void stop()
+    {
+      {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (!running)
+          return;
+        running = false;
+        queue_cv.notify_one();
+      }
+      writer_thread.join();
+    }
+
+  private:
+    void run()
+    {
+      std::deque<std::pair<time_t, std::string>> pending;
+      bool stopping = false;
+
+      while (!stopping)
+      {
+        {
+          std::unique_lock<std::mutex> lock(queue_mutex);
+          queue_cv.wait_for(lock, std::chrono::seconds(1), [this]
+                            { return !queue.empty() || !running; });
+          pending.swap(queue);
+          queued_bytes = 0;
+          stopping = !running;
+        }
+
+        for (auto &record : pending)
+        {
+          if (!segment.is_open() || (record.first - segment_start) >= segment_seconds_)
+          {
+            write_block();
+            open_segment(record.first);
+          }
+
+          if (block_count == 0)
+            block_first = record.first;
+          block_last = record.first;
+          block_count++;
+          block.append(record.second);
+
+          if (block.size() >= block_size_)
+            write_block();
+        }
+        pending.clear();
+
+        // Limit how long a partial block waits in memory
+        if ((block_count > 0) && (stopping || (time(NULL) - block_first) >= flush_seconds))
+          write_block();
+      }
+
+      if (dropped > 0)
+        BOOST_LOG_TRIVIAL(error) << log_prefix << "Archive queue full, " << dropped << " messages were not archived";
+      close_segment();
+    }
+
+    void open_segment(time_t start_time)
+    {
+      close_segment();
+
+      char name[32];
+      struct tm start_tm;
+      gmtime_r(&start_time, &start_tm);
+      strftime(name, sizeof(name), "mqtt-%Y%m%dT%H%M%SZ", &start_tm);
+
+      std::string segment_path = archive_dir + "/" + name + ".ndjson.gz";
+      boost::system::error_code ec;
+      segment_offset = boost::filesystem::file_size(segment_path, ec);
+      if (ec)
+        segment_offset = 0;
+
+      segment.open(segment_path, std::ios::binary | std::ios::app);
+      index.open(archive_dir + "/" + name + ".idx", std::ios::app);
+      segment_start = start_time;
+
+      if (!segment.is_open())
+        BOOST_LOG_TRIVIAL(error) << log_prefix << "Unable to open archive segment " << segment_path;
+    }
+
+    void close_segment()
+    {
+      if (segment.is_open())
+        segment.close();
+      if (index.is_open())
+        index.close();
+    }
+
+    // write_block()
+    //   Compress the pending block as a gzip member, append it to the segment, and record it in the index.
+    void write_block()
+    {
+      if (block_count == 0)
+        return;
+
+      std::string compressed;
+      if (segment.is_open() && Mqtt_Status::zlib_compress(block, compressed, Z_DEFAULT_COMPRESSION, true))
+      {
+        segment.write(compressed.data(), compressed.size());
+        segment.flush();
+
+        nlohmann::ordered_json index_json = {
+            {"offset", segment_offset},
+            {"length", compressed.size()},
+            {"first_time", block_first},
+            {"last_time", block_last},
+            {"count", block_count}};
+        index << index_json.dump() << "\n";
+        index.flush();
+        segment_offset += compressed.size();
+      }
+
+      block.clear();
+      block_count = 0;
+    }
+
+    std::string archive_dir;
+    std::string log_prefix;
+    int segment_seconds_ = 3600;
+    size_t block_size_ = 262144;
+    const size_t max_queued_bytes = 64 * 1024 * 1024;
+    const time_t flush_seconds = 10;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<std::pair<time_t, std::string>> queue;
+    size_t queued_bytes = 0;
+    uint64_t dropped = 0;
+    bool running = false;
+    std::thread writer_thread;
+
+    // Writer thread only
+    std::ofstream segment;
+    std::ofstream index;
+    uint64_t segment_offset = 0;
+    time_t segment_start = 0;
+    std::string block;
+    time_t block_first = 0;
+    time_t block_last = 0;
+    int block_count = 0;
+  };
+
+  Archive_Writer archive_writer;
+
   // Custom backend to send log messages to parent Mqtt_Status plugin
   class MqttSinkBackend : public logging::sinks::text_ostream_backend
   {
@@ -192,6 +935,12 @@ private:
 public:
   Mqtt_Status(){};
 
+  ~Mqtt_Status()
+  {
+    stop_opus_encoder();
+    stop_send_shards();
+  }
+
   // ********************************
   // trunk-recorder MQTT messages
   // ********************************
@@ -210,25 +959,68 @@ public:
   //   MQTT: topic_message/short_name
   int trunk_message(std::vector<TrunkMessage> messages, System *sys) override
   {
-    if ((message_enabled))
+    int64_t event_ms = system_ms();
+    int ret = 0;
+
+    // Note talkgroups with patch changes for the next update_patches()
+    for (std::vector<TrunkMessage>::iterator it = messages.begin(); it != messages.end(); it++)
+    {
+      if ((it->message_type == PATCH_ADD) || (it->message_type == PATCH_DELETE))
+      {
+        std::lock_guard<std::mutex> lock(patch_mutex);
+        Patch_Table &table = get_patch_table(sys->get_sys_num());
+        unsigned long patch_tgs[] = {it->patch_data.sg, it->patch_data.ga1, it->patch_data.ga2, it->patch_data.ga3};
+        for (unsigned long tg : patch_tgs)
+        {
+          if (tg != 0)
+            table.touched.insert(tg);
+        }
+      }
+    }
+
+    if (message_stats_enabled)
     {
+      Message_Stats &stats = get_message_stats(sys);
       for (std::vector<TrunkMessage>::iterator it = messages.begin(); it != messages.end(); it++)
       {
-        TrunkMessage message = *it;
+        stats.total++;
+        stats.message_type[message_type_index(it->message_type)]++;
+        stats.opcode[opcode_index(it->opcode)]++;
+      }
+    }
 
-        nlohmann::ordered_json message_json = {
-            {"sys_num", sys->get_sys_num()},
-            {"sys_name", sys->get_short_name()},
-            {"trunk_msg", message.message_type},
-            {"trunk_msg_type", message_type[message.message_type]},
-            {"opcode", int_to_hex(message.opcode, 2)},
-            {"opcode_type", opcode_type[message.opcode][0]},
-            {"opcode_desc", opcode_type[message.opcode][1]},
-            {"meta", strip_esc_seq(message.meta)}};
-        return send_json(message_json, "message", "message", topic_message + "/" + sys->get_short_name().c_str(), false);
+    if ((message_enabled))
+    {
+      for (std::vector<TrunkMessage>::iterator it = messages.begin(); it != messages.end(); it++)
+      {
+        int opcode = opcode_index(it->opcode);
+
+        if (!message_filter_pass(sys, opcode))
+          continue;
+
+        // The lookup tables are not changed after startup, so their entries can be read by the send shard
+        const std::string *trunk_msg_type = &message_type[it->message_type];
+        const std::vector<std::string> *opcode_names = &opcode_type[opcode];
+        MessageType trunk_msg = it->message_type;
+        int raw_opcode = it->opcode;
+        std::string meta = it->meta;
+        Json_Builder build = [this, sys, trunk_msg, trunk_msg_type, raw_opcode, opcode_names, meta]
+        {
+          nlohmann::ordered_json message_json = {
+              {"sys_num", sys->get_sys_num()},
+              {"sys_name", sys->get_short_name()},
+              {"trunk_msg", trunk_msg},
+              {"trunk_msg_type", *trunk_msg_type},
+              {"opcode", int_to_hex(raw_opcode, 2)},
+              {"opcode_type", (*opcode_names)[0]},
+              {"opcode_desc", (*opcode_names)[1]},
+              {"meta", strip_esc_seq(meta)}};
+          return message_json;
+        };
+        ret |= send_event(std::move(build), "message", "message", topic_message, true, {sys, 0, 0}, event_ms);
       }
     }
-    return 0;
+    return ret;
   }
 
   // system_rates()
@@ -249,94 +1041,207 @@ public:
       if (sys_type.find("conventional") == std::string::npos)
       {
         boost::property_tree::ptree stat_node = sys->get_stats_current(timeDiff);
+        if (rate_rollup_interval > 0)
+          add_rate_sample(sys, stat_node.get<double>("decoderate"), sys->get_current_control_channel());
+
         system_json += {
-            {"sys_num", stat_node.get<int>("id")},
+            {"sys_num", sys->get_sys_num()},
             {"sys_name", sys->get_short_name()},
             {"decoderate", round_float(stat_node.get<double>("decoderate"))},
             {"decoderate_interval", timeDiff},
             {"control_channel", sys->get_current_control_channel()}};
       }
     }
-    return send_json(system_json, "rates", "rates", topic_status, false);
+
+    int ret = 0;
+    int64_t now_ms = steady_ms();
+    if (schedule_due(rates_schedule, now_ms) && schedule_check(rates_schedule, hash_string(system_json.dump()), now_ms))
+      ret = send_json(system_json, "rates", "rates", topic_status, false);
+
+    if (message_stats_enabled)
+      ret |= send_message_stats(systems, timeDiff);
+
+    time_t now_time = time(NULL);
+    if ((rate_rollup_interval > 0) && ((now_time - rate_rollup_time) >= rate_rollup_interval))
+    {
+      ret |= send_rate_rollups(systems);
+      rate_rollup_time = now_time;
+    }
+    return ret;
   }
 
-  // send_config()
-  //   Send elements of the trunk recorder config.json on startup.
-  //   MQTT: topic/config
-  //     retained = true; Message will be kept at the MQTT broker to avoid the need to resend.
-  int send_config(std::vector<Source *> sources, std::vector<System *> systems)
+  // add_rate_sample()
+  //   Add a decode rate sample to a system's history and update the rolling windows.
+  void add_rate_sample(System *sys, double decoderate, double control_channel)
   {
-    nlohmann::ordered_json config_json;
+    int sys_num = sys->get_sys_num();
+    if (sys_num >= (int)rate_history.size())
+      rate_history.resize(sys_num + 1);
+    Rate_History &history = rate_history[sys_num];
 
-    for (std::vector<Source *>::iterator it = sources.begin(); it != sources.end(); ++it)
-    {
-      Source *source = *it;
-      json gain_stages_json;
-      std::vector<Gain_Stage_t> gain_stages = source->get_gain_stages();
+    int64_t now_ms = steady_ms();
+    uint64_t sample = history.count++;
+    history.sample_ms[sample % Rate_History::capacity] = now_ms;
+    history.sample_rate[sample % Rate_History::capacity] = decoderate;
 
-      for (std::vector<Gain_Stage_t>::iterator gain_it = gain_stages.begin(); gain_it != gain_stages.end(); ++gain_it)
+    for (Rate_Window &window : history.windows)
+    {
+      window.sum += decoderate;
+      while (!window.min_queue.empty() && (history.sample_rate[window.min_queue.back() % Rate_History::capacity] >= decoderate))
+        window.min_queue.pop_back();
+      window.min_queue.push_back(sample);
+      while (!window.max_queue.empty() && (history.sample_rate[window.max_queue.back() % Rate_History::capacity] <= decoderate))
+        window.max_queue.pop_back();
+      window.max_queue.push_back(sample);
+
+      // Drop samples older than the window, or about to be overwritten in the ring
+      while ((window.first < sample) &&
+             (((now_ms - history.sample_ms[window.first % Rate_History::capacity]) > window.span_ms) ||
+              ((sample - window.first) >= (uint64_t)Rate_History::capacity - 1)))
       {
-        gain_stages_json += {gain_it->stage_name + "_gain", gain_it->value};
+        window.sum -= history.sample_rate[window.first % Rate_History::capacity];
+        if (window.min_queue.front() == window.first)
+          window.min_queue.pop_front();
+        if (window.max_queue.front() == window.first)
+          window.max_queue.pop_front();
+        window.first++;
       }
+    }
 
-      config_json["sources"] += {
-          {"source_num", source->get_num()},
-          {"rate", source->get_rate()},
-          {"center", source->get_center()},
-          {"min_hz", source->get_min_hz()},
-          {"max_hz", source->get_max_hz()},
-          {"error", source->get_error()},
-          {"driver", source->get_driver()},
-          {"device", source->get_device()},
-          {"antenna", source->get_antenna()},
-          {"gain", source->get_gain()},
-          {"gain_stages", gain_stages_json},
-          {"analog_recorders", source->analog_recorder_count()},
-          {"digital_recorders", source->digital_recorder_count()},
-          {"debug_recorders", source->debug_recorder_count()},
-          {"sigmf_recorders", source->sigmf_recorder_count()},
-          {"silence_frames", source->get_silence_frames()}};
+    // Record control channel changes
+    if ((history.control_channel != 0) && (history.control_channel != control_channel))
+    {
+      history.change_ms[history.change_count++ % Rate_History::changes_capacity] = now_ms;
+      history.last_change = time(NULL);
     }
+    history.control_channel = control_channel;
+  }
+
+  // send_rate_rollups()
+  //   Send decode rate min/avg/max/5th percentile and control channel changes over the last 1, 5, and 15 minutes.
+  //   MQTT: topic/rate_rollup/short_name
+  //     retained = true; Message will be kept at the MQTT broker to avoid the need to resend.
+  int send_rate_rollups(std::vector<System *> systems)
+  {
+    int ret = 0;
+    int64_t now_ms = steady_ms();
 
     for (std::vector<System *>::iterator it = systems.begin(); it != systems.end(); ++it)
     {
-      System *sys = (System *)*it;
+      System *sys = *it;
+      int sys_num = sys->get_sys_num();
+      if ((sys_num >= (int)rate_history.size()) || (rate_history[sys_num].count == 0))
+        continue;
 
-      nlohmann::ordered_json system_json = {
-          {"sys_num", sys->get_sys_num()},
-          {"sys_name", sys->get_short_name()},
-          {"system_type", sys->get_system_type()},
-          {"talkgroups_file", sys->get_talkgroups_file()},
-          {"qpsk", sys->get_qpsk_mod()},
-          {"squelch_db", sys->get_squelch_db()},
-          {"analog_levels", sys->get_analog_levels()},
-          {"digital_levels", sys->get_digital_levels()},
-          {"audio_archive", sys->get_audio_archive()},
-          {"upload_script", sys->get_upload_script()},
-          {"record_unkown", sys->get_record_unknown()},
-          {"call_log", sys->get_call_log()}};
+      Rate_History &history = rate_history[sys_num];
+      uint64_t last = history.count - 1;
+      nlohmann::ordered_json windows_json;
 
-      if (sys->get_system_type().find("conventional") != std::string::npos)
+      for (Rate_Window &window : history.windows)
       {
-        system_json["channels"] = sys->get_channels();
+        uint64_t samples = last - window.first + 1;
+
+        // 5th percentile from the samples in the window
+        std::vector<float> rates;
+        rates.reserve(samples);
+        for (uint64_t sample = window.first; sample <= last; sample++)
+          rates.push_back(history.sample_rate[sample % Rate_History::capacity]);
+        std::vector<float>::iterator p5 = rates.begin() + (rates.size() - 1) / 20;
+        std::nth_element(rates.begin(), p5, rates.end());
+
+        int changes = 0;
+        for (uint64_t change = (history.change_count > Rate_History::changes_capacity) ? history.change_count - Rate_History::changes_capacity : 0; change < history.change_count; change++)
+        {
+          if ((now_ms - history.change_ms[change % Rate_History::changes_capacity]) <= window.span_ms)
+            changes++;
+        }
+
+        windows_json += {
+            {"window", window.span_ms / 1000},
+            {"samples", samples},
+            {"min", round_float(history.sample_rate[window.min_queue.front() % Rate_History::capacity])},
+            {"avg", round_float(window.sum / samples)},
+            {"max", round_float(history.sample_rate[window.max_queue.front() % Rate_History::capacity])},
+            {"p5", round_float(*p5)},
+            {"control_channel_changes", changes}};
       }
-      else
+
+      nlohmann::ordered_json rollup_json = {
+          {"sys_num", sys_num},
+          {"sys_name", sys->get_short_name()},
+          {"decoderate", round_float(history.sample_rate[last % Rate_History::capacity])},
+          {"control_channel", history.control_channel},
+          {"last_control_channel_change", history.last_change},
+          {"rollups", windows_json}};
+
+      ret |= send_json_topic(rollup_json, "rate_rollup", "rate_rollup", topic_status + "/rate_rollup/" + sys->get_short_name(), true);
+    }
+    return ret;
+  }
+
+  // send_message_stats()
+  //   Send a histogram of trunk message types and opcodes received since the last interval, then reset the counters.
+  //   Only non-zero counts are included.
+  //   MQTT: topic/message_stats
+  int send_message_stats(std::vector<System *> systems, float timeDiff)
+  {
+    nlohmann::ordered_json stats_json;
+
+    for (std::vector<System *>::iterator it = systems.begin(); it != systems.end(); ++it)
+    {
+      System *sys = *it;
+      if (sys->get_system_type().find("conventional") != std::string::npos)
+        continue;
+
+      Message_Stats &stats = get_message_stats(sys);
+      nlohmann::ordered_json types_json = nlohmann::ordered_json::object();
+      nlohmann::ordered_json opcodes_json = nlohmann::ordered_json::object();
+
+      for (std::map<short, std::string>::iterator type_it = message_type.begin(); type_it != message_type.end(); ++type_it)
       {
-        system_json["control_channel"] = sys->get_current_control_channel();
-        system_json["channels"] = sys->get_control_channels();
+        uint32_t count = stats.message_type[message_type_index(type_it->first)];
+        if (count > 0)
+          types_json[type_it->second] = count;
       }
 
-      if (sys->get_system_type() == "smartnet")
+      for (std::map<short, std::vector<std::string>>::iterator op_it = opcode_type.begin(); op_it != opcode_type.end(); ++op_it)
       {
-        system_json["bandplan"] = sys->get_bandplan();
-        system_json["bandfreq"] = sys->get_bandfreq();
-        system_json["bandplan_base"] = sys->get_bandplan_base();
-        system_json["bandplan_high"] = sys->get_bandplan_high();
-        system_json["bandplan_spacing"] = sys->get_bandplan_spacing();
-        system_json["bandplan_offset"] = sys->get_bandplan_offset();
+        uint32_t count = stats.opcode[op_it->first];
+        if (count > 0)
+          opcodes_json[op_it->second[0]] = count;
       }
 
-      config_json["systems"] += system_json;
+      stats_json += {
+          {"sys_num", sys->get_sys_num()},
+          {"sys_name", sys->get_short_name()},
+          {"interval", timeDiff},
+          {"total", stats.total},
+          {"message_types", types_json},
+          {"opcodes", opcodes_json}};
+
+      stats = Message_Stats();
+    }
+    return send_json(stats_json, "message_stats", "message_stats", topic_status, false);
+  }
+
+  // send_config()
+  //   Send elements of the trunk recorder config.json on startup.
+  //   MQTT: topic/config
+  //     retained = true; Message will be kept at the MQTT broker to avoid the need to resend.
+  int send_config(std::vector<Source *> sources, std::vector<System *> systems)
+  {
+    nlohmann::ordered_json config_json;
+
+    for (std::vector<Source *>::iterator it = sources.begin(); it != sources.end(); ++it)
+    {
+      Source *source = *it;
+      config_json["sources"] += get_source_config_json(source);
+    }
+
+    for (std::vector<System *>::iterator it = systems.begin(); it != systems.end(); ++it)
+    {
+      System *sys = (System *)*it;
+      config_json["systems"] += get_system_config_json(sys);
     }
 
     config_json["capture_dir"] = tr_config->capture_dir;
@@ -353,20 +1258,136 @@ public:
     return send_json(config_json, "config", "config", topic_status, true);
   }
 
-  // setup_systems()
-  //   Send the configuration information for all systems on startup.
-  //   TRUNK-RECORDER PLUGIN API: Called during startup when the systems have been created.
-  //   MQTT: topic/systems
-  //     retained = true; Message will be kept at the MQTT broker to avoid the need to resend.
-  int setup_systems(std::vector<System *> systems) override
+  // get_source_config_json()
+  //   Return a JSON object for the config of a source.
+  nlohmann::ordered_json get_source_config_json(Source *source)
   {
-    nlohmann::ordered_json systems_json;
+    json gain_stages_json;
+    std::vector<Gain_Stage_t> gain_stages = source->get_gain_stages();
 
-    for (std::vector<System *>::iterator it = systems.begin(); it != systems.end(); ++it)
+    for (std::vector<Gain_Stage_t>::iterator gain_it = gain_stages.begin(); gain_it != gain_stages.end(); ++gain_it)
     {
-      System *system = *it;
-      systems_json += get_system_json(system);
+      gain_stages_json += {gain_it->stage_name + "_gain", gain_it->value};
     }
+
+    nlohmann::ordered_json source_json = {
+        {"source_num", source->get_num()},
+        {"rate", source->get_rate()},
+        {"center", source->get_center()},
+        {"min_hz", source->get_min_hz()},
+        {"max_hz", source->get_max_hz()},
+        {"error", source->get_error()},
+        {"driver", source->get_driver()},
+        {"device", source->get_device()},
+        {"antenna", source->get_antenna()},
+        {"gain", source->get_gain()},
+        {"gain_stages", gain_stages_json},
+        {"analog_recorders", source->analog_recorder_count()},
+        {"digital_recorders", source->digital_recorder_count()},
+        {"debug_recorders", source->debug_recorder_count()},
+        {"sigmf_recorders", source->sigmf_recorder_count()},
+        {"silence_frames", source->get_silence_frames()}};
+    return source_json;
+  }
+
+  // get_system_config_json()
+  //   Return a JSON object for the config of a system.
+  nlohmann::ordered_json get_system_config_json(System *sys)
+  {
+    nlohmann::ordered_json system_json = {
+        {"sys_num", sys->get_sys_num()},
+        {"sys_name", sys->get_short_name()},
+        {"system_type", sys->get_system_type()},
+        {"talkgroups_file", sys->get_talkgroups_file()},
+        {"qpsk", sys->get_qpsk_mod()},
+        {"squelch_db", sys->get_squelch_db()},
+        {"analog_levels", sys->get_analog_levels()},
+        {"digital_levels", sys->get_digital_levels()},
+        {"audio_archive", sys->get_audio_archive()},
+        {"upload_script", sys->get_upload_script()},
+        {"record_unkown", sys->get_record_unknown()},
+        {"call_log", sys->get_call_log()}};
+
+    if (sys->get_system_type().find("conventional") != std::string::npos)
+    {
+      system_json["channels"] = sys->get_channels();
+    }
+    else
+    {
+      system_json["control_channel"] = sys->get_current_control_channel();
+      system_json["channels"] = sys->get_control_channels();
+    }
+
+    if (sys->get_system_type() == "smartnet")
+    {
+      system_json["bandplan"] = sys->get_bandplan();
+      system_json["bandfreq"] = sys->get_bandfreq();
+      system_json["bandplan_base"] = sys->get_bandplan_base();
+      system_json["bandplan_high"] = sys->get_bandplan_high();
+      system_json["bandplan_spacing"] = sys->get_bandplan_spacing();
+      system_json["bandplan_offset"] = sys->get_bandplan_offset();
+    }
+    return system_json;
+  }
+
+  // send_system_entity()
+  //   Publish a system's status and config to its own retained topic when it changes.
+  //   MQTT: topic/systems/<short_name>
+  //     retained = true
+  void send_system_entity(System *sys)
+  {
+    nlohmann::ordered_json system_json = get_system_json(sys);
+    system_json.update(get_system_config_json(sys));
+    send_entity(system_entities, topic_status + "/systems/" + sys->get_short_name(), system_json, system_json, "system", "system_state");
+  }
+
+  // send_setup_entities()
+  //   Publish each source and system to its own retained topic, and an index of them, sending only those that changed.
+  //   Called on startup and by setup_config(), so systems that learn their sysid/wacn/nac later are updated.
+  //   MQTT: topic/sources/<source_num>
+  //   MQTT: topic/systems/<short_name>
+  //   MQTT: topic/index
+  //     retained = true
+  void send_setup_entities(std::vector<Source *> sources, std::vector<System *> systems)
+  {
+    nlohmann::ordered_json index_json = {
+        {"sources", nlohmann::ordered_json::array()},
+        {"systems", nlohmann::ordered_json::array()}};
+
+    for (std::vector<Source *>::iterator it = sources.begin(); it != sources.end(); ++it)
+    {
+      Source *source = *it;
+      nlohmann::ordered_json source_json = get_source_config_json(source);
+      send_entity(source_entities, topic_status + "/sources/" + std::to_string(source->get_num()), source_json, source_json, "source", "source_state");
+      index_json["sources"] += source->get_num();
+    }
+
+    for (std::vector<System *>::iterator it = systems.begin(); it != systems.end(); ++it)
+    {
+      System *sys = *it;
+      send_system_entity(sys);
+      index_json["systems"] += sys->get_short_name();
+    }
+
+    send_entity(index_entity, topic_status + "/index", index_json, index_json, "index", "index");
+  }
+
+  // setup_systems()
+  //   Send the configuration information for all systems on startup.
+  //   TRUNK-RECORDER PLUGIN API: Called during startup when the systems have been created.
+  //   MQTT: topic/systems
+  //     retained = true; Message will be kept at the MQTT broker to avoid the need to resend.
+  int setup_systems(std::vector<System *> systems) override
+  {
+    nlohmann::ordered_json systems_json;
+    uint64_t mask = get_field_mask("systems");
+
+    for (std::vector<System *>::iterator it = systems.begin(); it != systems.end(); ++it)
+    {
+      System *system = *it;
+      systems_json += get_system_json(system, mask);
+    }
+    systems_dirty = false;
     return send_json(systems_json, "systems", "systems", topic_status, true);
   }
 
@@ -374,10 +1395,13 @@ public:
   //   Send the configuration information for a single system on startup.
   //   TRUNK-RECORDER PLUGIN API:  Called after a system has been created.
   //   MQTT: topic/system
+  //   MQTT: topic/systems/<short_name>
   int setup_system(System *system) override
   {
-    setup_systems(tr_systems);
-    nlohmann::ordered_json system_json = get_system_json(system);
+    // The retained systems list is sent once by setup_config() for any number of new systems
+    systems_dirty = true;
+    send_system_entity(system);
+    nlohmann::ordered_json system_json = get_system_json(system, get_field_mask("system"));
     return send_json(system_json, "system", "system", topic_status, false);
   }
 
@@ -396,32 +1420,109 @@ public:
   //   MQTT: topic/calls_active
   //     Not all calls have recorder info
   int send_calls(std::vector<Call *> calls)
+  {
+    nlohmann::ordered_json calls_json = get_calls_json(calls);
+
+    if (entity_topics)
+      send_call_entities(calls_json);
+
+    schedule_sent(calls_schedule, calls_hash(calls_json), steady_ms());
+    return send_json(calls_json, "calls", "calls_active", topic_status, false);
+  }
+
+  // get_calls_json()
+  //   Return a JSON array of active calls.
+  nlohmann::ordered_json get_calls_json(std::vector<Call *> calls)
   {
     nlohmann::ordered_json calls_json;
+    uint64_t mask = get_field_mask("calls_active");
     for (std::vector<Call *>::iterator it = calls.begin(); it != calls.end(); ++it)
     {
       Call *call = *it;
       // Filter out intactive conventional calls
       if ((call->get_current_length() > 0) || (!call->is_conventional()))
       {
-        calls_json += get_call_json(call);
+        calls_json += get_call_json(call, mask);
       }
     }
-    return send_json(calls_json, "calls", "calls_active", topic_status, false);
+    return calls_json;
+  }
+
+  // send_call_entities()
+  //   Publish each active call to its own retained topic when it changes, and clear calls no longer active.
+  //   "elapsed" and "length" are not compared, since they change every second while a call is recorded; consumers
+  //   can derive them from "start_time".
+  //   MQTT: topic/calls/<call id>
+  //     retained = true
+  void send_call_entities(const nlohmann::ordered_json &calls_json)
+  {
+    std::set<std::string> active_topics;
+    std::lock_guard<std::mutex> lock(call_entities_mutex);
+
+    for (auto &call_json : calls_json)
+    {
+      std::string topic = topic_status + "/calls/" + call_json["id"].get<std::string>();
+      active_topics.insert(topic);
+
+      nlohmann::ordered_json compare_json = call_json;
+      compare_json.erase("elapsed");
+      compare_json.erase("length");
+      send_entity(call_entities, topic, call_json, compare_json, "call", "active_call");
+    }
+
+    for (std::map<std::string, size_t>::iterator it = call_entities.begin(); it != call_entities.end();)
+    {
+      if (active_topics.find(it->first) == active_topics.end())
+      {
+        clear_retained(it->first);
+        it = call_entities.erase(it);
+      }
+      else
+        ++it;
+    }
+  }
+
+  // send_recorder_entity()
+  //   Publish a recorder to its own retained topic when it changes.
+  //   MQTT: topic/recorders/<recorder id>
+  //     retained = true
+  void send_recorder_entity(const nlohmann::ordered_json &recorder_json)
+  {
+    std::string topic = topic_status + "/recorders/" + recorder_json["id"].get<std::string>();
+    send_entity(recorder_entities, topic, recorder_json, recorder_json, "recorder", "recorder_state");
+  }
+
+  // send_entity()
+  //   Send a retained entity message if the hash of compare_json differs from the last one sent to the topic.
+  void send_entity(std::map<std::string, size_t> &entities, const std::string &topic, const nlohmann::ordered_json &data, const nlohmann::ordered_json &compare_json, std::string name, std::string type)
+  {
+    size_t hash = std::hash<std::string>{}(compare_json.dump());
+    std::map<std::string, size_t>::iterator it = entities.find(topic);
+    if ((it != entities.end()) && (it->second == hash))
+      return;
+
+    entities[topic] = hash;
+    send_json_topic(data, name, type, topic, true);
   }
 
   // send_recorders()
   //   Send the status of all recorders.
   //   MQTT: topic/recorders
-  int send_recorders(std::vector<Recorder *> recorders)
+  int send_recorders(std::vector<Recorder *> recorders, int64_t now_ms)
   {
     nlohmann::ordered_json recorders_json;
+    uint64_t mask = get_field_mask("recorders");
 
     for (std::vector<Recorder *>::iterator it = recorders.begin(); it != recorders.end(); ++it)
     {
       Recorder *recorder = *it;
-      recorders_json += get_recorder_json(recorder);
+      recorders_json += get_recorder_json(recorder, mask);
+      if (entity_topics)
+        send_recorder_entity(recorders_json.back());
     }
+
+    if (!schedule_check(recorders_schedule, hash_string(recorders_json.dump()), now_ms))
+      return 0;
     return send_json(recorders_json, "recorders", "recorders", topic_status, false);
   }
 
@@ -431,7 +1532,15 @@ public:
   //   MQTT: topic/recorder
   int setup_recorder(Recorder *recorder) override
   {
-    nlohmann::ordered_json recorder_json = get_recorder_json(recorder);
+    uint64_t mask = get_field_mask("recorder");
+    nlohmann::ordered_json recorder_json = get_recorder_json(recorder, mask);
+
+    // Recorder entities always have the fields of the recorders list, so changes are compared alike
+    if (entity_topics)
+    {
+      uint64_t entity_mask = get_field_mask("recorders");
+      send_recorder_entity((entity_mask == mask) ? recorder_json : get_recorder_json(recorder, entity_mask));
+    }
     return send_json(recorder_json, "recorder", "recorder", topic_status, false);
   }
 
@@ -443,21 +1552,36 @@ public:
   //   MQTT: topic_unit/shortname/call
   int call_start(Call *call) override
   {
-    if (unit_enabled)
-    {
-      boost::property_tree::ptree stat_node = call->get_stats();
+    int64_t event_ms = system_ms();
 
-      nlohmann::ordered_json unit_json = get_unit_tg_json(call->get_system(), stat_node.get<long>("srcId"), stat_node.get<long>("talkgroup"));
-      unit_json["call_num"] = stat_node.get<int>("callNum");
-      unit_json["freq"] = stat_node.get<double>("freq");
-      unit_json["encrypted"] = stat_node.get<bool>("encrypted");
-      unit_json["start_time"] = stat_node.get<long>("startTime");
+    // Count calls that could not be recorded for lack of a recorder
+    if ((recorder_stats_interval > 0) && (call->get_monitoring_state() == NO_RECORDER))
+    {
+      int sys_num = call->get_sys_num();
+      if (sys_num >= (int)missed_calls.size())
+        missed_calls.resize(sys_num + 1);
+      missed_calls[sys_num]++;
+    }
 
-      send_json(unit_json, "call", "call", topic_unit + "/" + stat_node.get<std::string>("shortName"), false);
+    if (unit_enabled)
+    {
+      uint64_t mask = get_field_mask("call");
+
+      nlohmann::ordered_json unit_json = get_unit_tg_json(call->get_system(), call->get_current_source_id(), call->get_talkgroup(), mask);
+      if (has_field(mask, UNIT_CALL_NUM))
+        unit_json["call_num"] = call->get_call_num();
+      if (has_field(mask, UNIT_FREQ))
+        unit_json["freq"] = call->get_freq();
+      if (has_field(mask, UNIT_ENCRYPTED))
+        unit_json["encrypted"] = call->get_encrypted();
+      if (has_field(mask, UNIT_START_TIME))
+        unit_json["start_time"] = call->get_start_time();
+
+      send_event(unit_json, "call", "call", topic_unit, true, {call->get_system(), call->get_talkgroup(), call->get_current_source_id()}, event_ms);
     };
 
-    nlohmann::ordered_json call_json = get_call_json(call);
-    return send_json(call_json, "call", "call_start", topic_status, false);
+    nlohmann::ordered_json call_json = get_call_json(call, get_field_mask("call_start"));
+    return send_event(call_json, "call", "call_start", topic_status, false, {call->get_system(), call->get_talkgroup(), call->get_current_source_id()}, event_ms);
   }
 
   // call_end()
@@ -468,101 +1592,253 @@ public:
   int call_end(Call_Data_t call_info) override
   {
     System *sys = find_system(call_info.sys_num);
-    std::string patch_string = patches_to_str(call_info.patched_talkgroups);
+    std::string patch_string = get_patch_str(call_info.sys_num, call_info.talkgroup);
+    if (patch_string.empty())
+      patch_string = patches_to_str(call_info.patched_talkgroups);
+    std::string call_id = boost::lexical_cast<std::string>(call_info.sys_num) + "_" + boost::lexical_cast<std::string>(call_info.talkgroup) + "_" + boost::lexical_cast<std::string>(call_info.start_time);
 
-    if (unit_enabled)
+    if (activity_interval > 0)
+      add_call_activity(call_info);
+
+    if ((unit_enabled) && (unit_end_batch))
+      send_unit_end_batch(call_info, sys, patch_string);
+    else if (unit_enabled)
     {
       // source_list[] can be used to supplement transmission_list[] info
       std::vector<Call_Source> source_list = call_info.transmission_source_list;
       int transmission_num = 0;
+      uint64_t mask = get_field_mask("end");
 
       BOOST_FOREACH (auto &transmission, call_info.transmission_list)
       {
-        nlohmann::ordered_json unit_json = {
-            {"sys_num", call_info.sys_num},
-            {"sys_name", call_info.short_name},
-            {"unit", transmission.source},
-            {"unit_alpha_tag", source_list[transmission_num].tag},
-            {"talkgroup", call_info.talkgroup},
-            {"talkgroup_alpha_tag", call_info.talkgroup_alpha_tag},
-            {"talkgroup_description", call_info.talkgroup_description},
-            {"talkgroup_group", call_info.talkgroup_group},
-            {"talkgroup_tag", call_info.talkgroup_tag},
-            {"talkgroup_patches", patch_string},
-            {"call_num", call_info.call_num},
-            {"freq", call_info.freq},
-            {"position", round_float(source_list[transmission_num].position)},
-            {"length", round_float(transmission.length)},
-            {"emergency", source_list[transmission_num].emergency},
-            {"encrypted", call_info.encrypted},
-            {"start_time", transmission.start_time},
-            {"stop_time", transmission.stop_time},
-            {"error_count", transmission.error_count},
-            {"spike_count", transmission.spike_count},
-            {"sample_count", transmission.sample_count},
-            {"transmission_filename", transmission.filename}};
-        send_json(unit_json, "end", "end", topic_unit + "/" + call_info.short_name.c_str(), false);
+        nlohmann::ordered_json unit_json = nlohmann::ordered_json::object();
+        if (has_field(mask, UNIT_SYS_NUM))
+          unit_json["sys_num"] = call_info.sys_num;
+        if (has_field(mask, UNIT_SYS_NAME))
+          unit_json["sys_name"] = call_info.short_name;
+        if (has_field(mask, UNIT_UNIT))
+          unit_json["unit"] = transmission.source;
+        if (has_field(mask, UNIT_UNIT_ALPHA_TAG))
+          unit_json["unit_alpha_tag"] = source_list[transmission_num].tag;
+        if (has_field(mask, UNIT_TALKGROUP))
+          unit_json["talkgroup"] = call_info.talkgroup;
+        if (has_field(mask, UNIT_TALKGROUP_ALPHA_TAG))
+          unit_json["talkgroup_alpha_tag"] = call_info.talkgroup_alpha_tag;
+        if (has_field(mask, UNIT_TALKGROUP_DESCRIPTION))
+          unit_json["talkgroup_description"] = call_info.talkgroup_description;
+        if (has_field(mask, UNIT_TALKGROUP_GROUP))
+          unit_json["talkgroup_group"] = call_info.talkgroup_group;
+        if (has_field(mask, UNIT_TALKGROUP_TAG))
+          unit_json["talkgroup_tag"] = call_info.talkgroup_tag;
+        if (has_field(mask, UNIT_TALKGROUP_PATCHES))
+          unit_json["talkgroup_patches"] = patch_string;
+        if (has_field(mask, UNIT_CALL_NUM))
+          unit_json["call_num"] = call_info.call_num;
+        if (has_field(mask, UNIT_FREQ))
+          unit_json["freq"] = call_info.freq;
+        if (has_field(mask, UNIT_POSITION))
+          unit_json["position"] = round_float(source_list[transmission_num].position);
+        if (has_field(mask, UNIT_LENGTH))
+          unit_json["length"] = round_float(transmission.length);
+        if (has_field(mask, UNIT_EMERGENCY))
+          unit_json["emergency"] = source_list[transmission_num].emergency;
+        if (has_field(mask, UNIT_ENCRYPTED))
+          unit_json["encrypted"] = call_info.encrypted;
+        if (has_field(mask, UNIT_START_TIME))
+          unit_json["start_time"] = transmission.start_time;
+        if (has_field(mask, UNIT_STOP_TIME))
+          unit_json["stop_time"] = transmission.stop_time;
+        if (has_field(mask, UNIT_ERROR_COUNT))
+          unit_json["error_count"] = transmission.error_count;
+        if (has_field(mask, UNIT_SPIKE_COUNT))
+          unit_json["spike_count"] = transmission.spike_count;
+        if (has_field(mask, UNIT_SAMPLE_COUNT))
+          unit_json["sample_count"] = transmission.sample_count;
+        if (has_field(mask, UNIT_TRANSMISSION_FILENAME))
+          unit_json["transmission_filename"] = transmission.filename;
+        send_event(unit_json, "end", "end", topic_unit, true, {sys, call_info.talkgroup, transmission.source});
         transmission_num++;
       }
     }
 
-    nlohmann::ordered_json call_json = {
-        {"id", boost::lexical_cast<std::string>(call_info.sys_num) + "_" + boost::lexical_cast<std::string>(call_info.talkgroup) + "_" + boost::lexical_cast<std::string>(call_info.start_time)},
-        {"call_num", call_info.call_num},
-        {"sys_num", call_info.sys_num},
-        {"sys_name", call_info.short_name},
-        {"freq", call_info.freq},
-        {"unit", call_info.transmission_source_list[0].source},
-        {"unit_alpha_tag", call_info.transmission_source_list[0].tag},
-        {"talkgroup", call_info.talkgroup},
-        {"talkgroup_alpha_tag", call_info.talkgroup_alpha_tag},
-        {"talkgroup_description", call_info.talkgroup_description},
-        {"talkgroup_group", call_info.talkgroup_group},
-        {"talkgroup_tag", call_info.talkgroup_tag},
-        {"talkgroup_patches", patch_string},
-        {"elapsed", call_info.stop_time - call_info.start_time},
-        {"length", round_float(call_info.length)},
-        {"call_state", -1},
-        {"call_state_type", "COMPLETED"},
-        {"mon_state", 0},
-        {"mon_state_type", "UNSPECIFIED"},
-        {"audio_type", call_info.audio_type},
-        {"phase2_tdma", call_info.phase2_tdma},
-        {"tdma_slot", call_info.tdma_slot},
-        {"analog", ((call_info.audio_type == "analog") ? true : false)},
-        {"rec_num", call_info.recorder_num},
-        {"src_num", call_info.source_num},
-        {"rec_state", 6},
-        {"rec_state_type", "STOPPED"},
-        {"conventional", ((sys->get_system_type()).find("conventional") == std::string::npos ? false : true)},
-        {"encrypted", call_info.encrypted},
-        {"emergency", call_info.emergency},
-        {"start_time", call_info.start_time},
-        {"stop_time", call_info.stop_time},
-        {"process_call_time", call_info.process_call_time},
-        {"error_count", call_info.error_count},
-        {"spike_count", call_info.spike_count},
-        {"retry_attempt", call_info.retry_attempt},
-        {"freq_error", call_info.freq_error},
-        {"signal", round_float(call_info.signal)},
-        {"noise", round_float(call_info.noise)},
-        {"call_filename", call_info.filename}};
-
-    if (call_info.compress_wav)
-    {
-      call_json["call_filename"] = call_info.converted;
+    uint64_t mask = get_field_mask("call_end");
+    nlohmann::ordered_json call_json = nlohmann::ordered_json::object();
+    if (has_field(mask, CALL_ID))
+      call_json["id"] = call_id;
+    if (has_field(mask, CALL_CALL_NUM))
+      call_json["call_num"] = call_info.call_num;
+    if (has_field(mask, CALL_SYS_NUM))
+      call_json["sys_num"] = call_info.sys_num;
+    if (has_field(mask, CALL_SYS_NAME))
+      call_json["sys_name"] = call_info.short_name;
+    if (has_field(mask, CALL_FREQ))
+      call_json["freq"] = call_info.freq;
+    if (has_field(mask, CALL_UNIT))
+      call_json["unit"] = call_info.transmission_source_list[0].source;
+    if (has_field(mask, CALL_UNIT_ALPHA_TAG))
+      call_json["unit_alpha_tag"] = call_info.transmission_source_list[0].tag;
+    if (has_field(mask, CALL_TALKGROUP))
+      call_json["talkgroup"] = call_info.talkgroup;
+    if (has_field(mask, CALL_TALKGROUP_ALPHA_TAG))
+      call_json["talkgroup_alpha_tag"] = call_info.talkgroup_alpha_tag;
+    if (has_field(mask, CALL_TALKGROUP_DESCRIPTION))
+      call_json["talkgroup_description"] = call_info.talkgroup_description;
+    if (has_field(mask, CALL_TALKGROUP_GROUP))
+      call_json["talkgroup_group"] = call_info.talkgroup_group;
+    if (has_field(mask, CALL_TALKGROUP_TAG))
+      call_json["talkgroup_tag"] = call_info.talkgroup_tag;
+    if (has_field(mask, CALL_TALKGROUP_PATCHES))
+      call_json["talkgroup_patches"] = patch_string;
+    if (has_field(mask, CALL_ELAPSED))
+      call_json["elapsed"] = call_info.stop_time - call_info.start_time;
+    if (has_field(mask, CALL_LENGTH))
+      call_json["length"] = round_float(call_info.length);
+    if (has_field(mask, CALL_CALL_STATE))
+      call_json["call_state"] = -1;
+    if (has_field(mask, CALL_CALL_STATE_TYPE))
+      call_json["call_state_type"] = "COMPLETED";
+    if (has_field(mask, CALL_MON_STATE))
+      call_json["mon_state"] = 0;
+    if (has_field(mask, CALL_MON_STATE_TYPE))
+      call_json["mon_state_type"] = "UNSPECIFIED";
+    if (has_field(mask, CALL_AUDIO_TYPE))
+      call_json["audio_type"] = call_info.audio_type;
+    if (has_field(mask, CALL_PHASE2_TDMA))
+      call_json["phase2_tdma"] = call_info.phase2_tdma;
+    if (has_field(mask, CALL_TDMA_SLOT))
+      call_json["tdma_slot"] = call_info.tdma_slot;
+    if (has_field(mask, CALL_ANALOG))
+      call_json["analog"] = ((call_info.audio_type == "analog") ? true : false);
+    if (has_field(mask, CALL_REC_NUM))
+      call_json["rec_num"] = call_info.recorder_num;
+    if (has_field(mask, CALL_SRC_NUM))
+      call_json["src_num"] = call_info.source_num;
+    if (has_field(mask, CALL_REC_STATE))
+      call_json["rec_state"] = 6;
+    if (has_field(mask, CALL_REC_STATE_TYPE))
+      call_json["rec_state_type"] = "STOPPED";
+    if (has_field(mask, CALL_CONVENTIONAL))
+      call_json["conventional"] = ((sys->get_system_type()).find("conventional") == std::string::npos ? false : true);
+    if (has_field(mask, CALL_ENCRYPTED))
+      call_json["encrypted"] = call_info.encrypted;
+    if (has_field(mask, CALL_EMERGENCY))
+      call_json["emergency"] = call_info.emergency;
+    if (has_field(mask, CALL_START_TIME))
+      call_json["start_time"] = call_info.start_time;
+    if (has_field(mask, CALL_STOP_TIME))
+      call_json["stop_time"] = call_info.stop_time;
+    if (has_field(mask, CALL_PROCESS_CALL_TIME))
+      call_json["process_call_time"] = call_info.process_call_time;
+    if (has_field(mask, CALL_ERROR_COUNT))
+      call_json["error_count"] = call_info.error_count;
+    if (has_field(mask, CALL_SPIKE_COUNT))
+      call_json["spike_count"] = call_info.spike_count;
+    if (has_field(mask, CALL_RETRY_ATTEMPT))
+      call_json["retry_attempt"] = call_info.retry_attempt;
+    if (has_field(mask, CALL_FREQ_ERROR))
+      call_json["freq_error"] = call_info.freq_error;
+    if (has_field(mask, CALL_SIGNAL))
+      call_json["signal"] = round_float(call_info.signal);
+    if (has_field(mask, CALL_NOISE))
+      call_json["noise"] = round_float(call_info.noise);
+    if (has_field(mask, CALL_CALL_FILENAME))
+      call_json["call_filename"] = (call_info.compress_wav) ? call_info.converted : call_info.filename;
+
+    // Clear the call's retained topic
+    if (entity_topics)
+    {
+      std::string entity_topic = topic_status + "/calls/" + call_id;
+      std::lock_guard<std::mutex> lock(call_entities_mutex);
+      if (call_entities.erase(entity_topic) > 0)
+        clear_retained(entity_topic);
     }
 
     int ret = 0;
     
     if (mqtt_audio)
     {
-      ret = send_audio(call_info);
+      if (mqtt_audio_type == "opus")
+        ret = queue_opus_audio(call_info);
+      else
+        ret = send_audio(call_info);
+    }
+
+    return (ret || send_event(call_json, "call", "call_end", topic_status, false, {sys, call_info.talkgroup, call_info.transmission_source_list[0].source}));
+  }
+
+  // send_unit_end_batch()
+  //   Send one end message for a call, with the call's fields once and an array of its transmissions.
+  //   MQTT: topic_unit/shortname/end
+  int send_unit_end_batch(const Call_Data_t &call_info, System *sys, const std::string &patch_string)
+  {
+    const std::vector<Call_Source> &source_list = call_info.transmission_source_list;
+    uint64_t mask = get_field_mask("end");
+
+    nlohmann::ordered_json unit_json = nlohmann::ordered_json::object();
+    if (has_field(mask, UNIT_SYS_NUM))
+      unit_json["sys_num"] = call_info.sys_num;
+    if (has_field(mask, UNIT_SYS_NAME))
+      unit_json["sys_name"] = call_info.short_name;
+    if (has_field(mask, UNIT_TALKGROUP))
+      unit_json["talkgroup"] = call_info.talkgroup;
+    if (has_field(mask, UNIT_TALKGROUP_ALPHA_TAG))
+      unit_json["talkgroup_alpha_tag"] = call_info.talkgroup_alpha_tag;
+    if (has_field(mask, UNIT_TALKGROUP_DESCRIPTION))
+      unit_json["talkgroup_description"] = call_info.talkgroup_description;
+    if (has_field(mask, UNIT_TALKGROUP_GROUP))
+      unit_json["talkgroup_group"] = call_info.talkgroup_group;
+    if (has_field(mask, UNIT_TALKGROUP_TAG))
+      unit_json["talkgroup_tag"] = call_info.talkgroup_tag;
+    if (has_field(mask, UNIT_TALKGROUP_PATCHES))
+      unit_json["talkgroup_patches"] = patch_string;
+    if (has_field(mask, UNIT_CALL_NUM))
+      unit_json["call_num"] = call_info.call_num;
+    if (has_field(mask, UNIT_FREQ))
+      unit_json["freq"] = call_info.freq;
+    if (has_field(mask, UNIT_ENCRYPTED))
+      unit_json["encrypted"] = call_info.encrypted;
+    if (has_field(mask, UNIT_START_TIME))
+      unit_json["start_time"] = call_info.start_time;
+    if (has_field(mask, UNIT_STOP_TIME))
+      unit_json["stop_time"] = call_info.stop_time;
+
+    nlohmann::ordered_json transmissions_json = nlohmann::ordered_json::array();
+    for (size_t transmission_num = 0; transmission_num < call_info.transmission_list.size(); transmission_num++)
+    {
+      const Transmission &transmission = call_info.transmission_list[transmission_num];
+      nlohmann::ordered_json transmission_json = nlohmann::ordered_json::object();
+      if (has_field(mask, UNIT_UNIT))
+        transmission_json["unit"] = transmission.source;
+      if ((has_field(mask, UNIT_UNIT_ALPHA_TAG)) && (transmission_num < source_list.size()))
+        transmission_json["unit_alpha_tag"] = source_list[transmission_num].tag;
+      if ((has_field(mask, UNIT_POSITION)) && (transmission_num < source_list.size()))
+        transmission_json["position"] = round_float(source_list[transmission_num].position);
+      if (has_field(mask, UNIT_LENGTH))
+        transmission_json["length"] = round_float(transmission.length);
+      if ((has_field(mask, UNIT_EMERGENCY)) && (transmission_num < source_list.size()))
+        transmission_json["emergency"] = source_list[transmission_num].emergency;
+      if (has_field(mask, UNIT_START_TIME))
+        transmission_json["start_time"] = transmission.start_time;
+      if (has_field(mask, UNIT_STOP_TIME))
+        transmission_json["stop_time"] = transmission.stop_time;
+      if (has_field(mask, UNIT_ERROR_COUNT))
+        transmission_json["error_count"] = transmission.error_count;
+      if (has_field(mask, UNIT_SPIKE_COUNT))
+        transmission_json["spike_count"] = transmission.spike_count;
+      if (has_field(mask, UNIT_SAMPLE_COUNT))
+        transmission_json["sample_count"] = transmission.sample_count;
+      if (has_field(mask, UNIT_TRANSMISSION_FILENAME))
+        transmission_json["transmission_filename"] = transmission.filename;
+      transmissions_json += transmission_json;
     }
+    unit_json["transmissions"] = transmissions_json;
 
-    return (ret || send_json(call_json, "call", "call_end", topic_status, false));
+    return send_event(unit_json, "end", "end", topic_unit, true, {sys, call_info.talkgroup, 0});
   }
 
+  // send_audio()
+  //   Send the call audio as base64 with the call metadata.
+  //   MQTT: topic/audio
   int send_audio(Call_Data_t call_info) {
     // Encode the audio file to base64
 
@@ -604,6 +1880,170 @@ public:
   }
 
 
+  // queue_opus_audio()
+  //   Queue a call for Opus encoding on the audio thread.  The wav is hard linked (or copied) first, since
+  //   trunk-recorder may remove it once call_end() returns.
+  int queue_opus_audio(Call_Data_t call_info)
+  {
+    std::string loghdr = log_header(call_info.short_name, call_info.call_num, call_info.talkgroup_display, call_info.freq);
+
+    // The encoder did not start (or has stopped); log it once rather than for every call
+    {
+      std::lock_guard<std::mutex> lock(opus_mutex);
+      if (!opus_running)
+      {
+        if (!opus_stopped_logged)
+          BOOST_LOG_TRIVIAL(error) << loghdr << "MQTT Call Upload error - Opus encoder is not running, audio will not be sent";
+        opus_stopped_logged = true;
+        return 1;
+      }
+    }
+
+    std::string wav_copy = opus_dir + "/" + get_filename_from_path(call_info.filename);
+    boost::system::error_code ec;
+    boost::filesystem::create_hard_link(call_info.filename, wav_copy, ec);
+    if (ec)
+      boost::filesystem::copy_file(call_info.filename, wav_copy, boost::filesystem::copy_options::overwrite_existing, ec);
+    if (ec)
+    {
+      BOOST_LOG_TRIVIAL(error) << loghdr << "MQTT Call Upload error - unable to copy " << call_info.filename << ": " << ec.message();
+      return 1;
+    }
+
+    std::lock_guard<std::mutex> lock(opus_mutex);
+    if ((!opus_running) || (opus_queue.size() >= opus_queue_max))
+    {
+      // The encoder may have stopped for shutdown since the check above
+      if (opus_running)
+        BOOST_LOG_TRIVIAL(error) << loghdr << "MQTT Call Upload error - Opus encoder queue full";
+      boost::filesystem::remove(wav_copy, ec);
+      return 1;
+    }
+    opus_queue.emplace_back(call_info, wav_copy);
+    opus_cv.notify_one();
+    return 0;
+  }
+
+  // start_opus_encoder()
+  //   Start the background thread that encodes and sends Opus audio.
+  void start_opus_encoder()
+  {
+    opus_dir = tr_config->capture_dir + "/mqtt_opus";
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(opus_dir, ec);
+    if (ec)
+    {
+      BOOST_LOG_TRIVIAL(error) << log_prefix << "Unable to create Opus directory " << opus_dir << ": " << ec.message();
+      return;
+    }
+
+    opus_running = true;
+    opus_thread = std::thread(&Mqtt_Status::opus_encoder_loop, this);
+  }
+
+  // stop_opus_encoder()
+  //   Encode and send the queued calls, then join the audio thread.  Calls still queued at deadline_ms
+  //   (steady_ms(), 0 for none) are abandoned; returns how many.
+  size_t stop_opus_encoder(int64_t deadline_ms = 0)
+  {
+    {
+      std::lock_guard<std::mutex> lock(opus_mutex);
+      if (!opus_running)
+        return 0;
+      opus_running = false;
+      opus_cv.notify_one();
+    }
+
+    size_t abandoned = 0;
+    if (deadline_ms > 0)
+    {
+      while ((get_opus_queued() > 0) && (steady_ms() < deadline_ms))
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+      std::lock_guard<std::mutex> lock(opus_mutex);
+      abandoned = opus_queue.size();
+      boost::system::error_code ec;
+      for (std::deque<std::pair<Call_Data_t, std::string>>::iterator it = opus_queue.begin(); it != opus_queue.end(); ++it)
+        boost::filesystem::remove(it->second, ec);
+      opus_queue.clear();
+    }
+    opus_thread.join();
+    return abandoned;
+  }
+
+  size_t get_opus_queued()
+  {
+    std::lock_guard<std::mutex> lock(opus_mutex);
+    return opus_queue.size();
+  }
+
+  void opus_encoder_loop()
+  {
+    while (true)
+    {
+      std::pair<Call_Data_t, std::string> job;
+      {
+        std::unique_lock<std::mutex> lock(opus_mutex);
+        opus_cv.wait(lock, [this]
+                     { return !opus_queue.empty() || !opus_running; });
+        if (opus_queue.empty())
+          return;
+        job = std::move(opus_queue.front());
+        opus_queue.pop_front();
+      }
+      send_opus_audio(job.first, job.second);
+    }
+  }
+
+  // send_opus_audio()
+  //   Encode a call to Ogg/Opus with opusenc at mqtt_audio_bitrate kbit/s, then send it as base64 with the call metadata.
+  //   Runs on the audio thread.
+  //   MQTT: topic/audio
+  int send_opus_audio(Call_Data_t call_info, std::string wav_copy)
+  {
+    std::string loghdr = log_header(call_info.short_name, call_info.call_num, call_info.talkgroup_display, call_info.freq);
+    std::string opus_file = wav_copy.substr(0, wav_copy.find_last_of('.')) + ".opus";
+    std::string command = "opusenc --quiet --bitrate " + std::to_string(mqtt_audio_bitrate) + " " + shell_quote(wav_copy) + " " + shell_quote(opus_file) + " > /dev/null 2>&1";
+
+    int ret = 1;
+    if (std::system(command.c_str()) == 0)
+    {
+      // Nothing above this thread would catch an exception; log it and remove the files below
+      try
+      {
+        nlohmann::ordered_json call_json = {
+            {"audio_wav_base64", ""},
+            {"audio_m4a_base64", ""},
+            {"audio_opus_base64", file_to_base64(opus_file)},
+            {"metadata", call_info.call_json}};
+        call_json["metadata"]["filename"] = get_filename_from_path(opus_file);
+
+        // Sent to the topic directly; stop() waits for queued audio after new events are refused
+        ret = send_json_topic(call_json, "call", "audio", topic_status + "/audio", false);
+
+        int size = call_json.dump().size();
+        if (ret == 0)
+          BOOST_LOG_TRIVIAL(info) << loghdr << "MQTT Call Upload Success - packet size: " << size;
+        else
+          BOOST_LOG_TRIVIAL(error) << loghdr << "MQTT Call Upload error - packet size: " << size;
+      }
+      catch (const std::exception &exc)
+      {
+        ret = 1;
+        BOOST_LOG_TRIVIAL(error) << loghdr << "MQTT Call Upload error - " << exc.what();
+      }
+    }
+    else
+    {
+      BOOST_LOG_TRIVIAL(error) << loghdr << "MQTT Call Upload error - opusenc failed: " << command;
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(wav_copy, ec);
+    boost::filesystem::remove(opus_file, ec);
+    return ret;
+  }
+
   // unit_registration()
   //   Unit registration on a system (on)
   //   TRUNK-RECORDER PLUGIN API: Called each REGISTRATION message
@@ -612,8 +2052,7 @@ public:
   {
     if (unit_enabled)
     {
-      nlohmann::ordered_json unit_json = get_unit_json(sys, source_id);
-      return send_json(unit_json, "on", "on", topic_unit + "/" + sys->get_short_name().c_str(), false);
+      return send_unit_event("on", sys, source_id);
     }
     return 0;
   }
@@ -626,8 +2065,7 @@ public:
   {
     if (unit_enabled)
     {
-      nlohmann::ordered_json unit_json = get_unit_json(sys, source_id);
-      return send_json(unit_json, "off", "off", topic_unit + "/" + sys->get_short_name().c_str(), false);
+      return send_unit_event("off", sys, source_id);
     }
     return 0;
   }
@@ -640,8 +2078,7 @@ public:
   {
     if (unit_enabled)
     {
-      nlohmann::ordered_json unit_json = get_unit_json(sys, source_id);
-      return send_json(unit_json, "ackresp", "ackresp", topic_unit + "/" + sys->get_short_name().c_str(), false);
+      return send_unit_event("ackresp", sys, source_id);
     }
     return 0;
   }
@@ -654,8 +2091,7 @@ public:
   {
     if (unit_enabled)
     {
-      nlohmann::ordered_json unit_json = get_unit_tg_json(sys, source_id, talkgroup_num);
-      return send_json(unit_json, "join", "join", topic_unit + "/" + sys->get_short_name().c_str(), false);
+      return send_unit_tg_event("join", sys, source_id, talkgroup_num);
     }
     return 0;
   }
@@ -668,8 +2104,7 @@ public:
   {
     if (unit_enabled)
     {
-      nlohmann::ordered_json unit_json = get_unit_json(sys, source_id);
-      return send_json(unit_json, "data", "data", topic_unit + "/" + sys->get_short_name().c_str(), false);
+      return send_unit_event("data", sys, source_id);
     }
     return 0;
   }
@@ -681,8 +2116,7 @@ public:
   {
     if (unit_enabled)
     {
-      nlohmann::ordered_json unit_json = get_unit_tg_json(sys, source_id, talkgroup_num);
-      return send_json(unit_json, "ans_req", "ans_req", topic_unit + "/" + sys->get_short_name().c_str(), false);
+      return send_unit_tg_event("ans_req", sys, source_id, talkgroup_num);
     }
     return 0;
   }
@@ -695,12 +2129,34 @@ public:
   {
     if (unit_enabled)
     {
-      nlohmann::ordered_json unit_json = get_unit_tg_json(sys, source_id, talkgroup_num);
-      return send_json(unit_json, "location", "location", topic_unit + "/" + sys->get_short_name().c_str(), false);
+      return send_unit_tg_event("location", sys, source_id, talkgroup_num);
     }
     return 0;
   }
 
+  // send_unit_event()
+  //   send_event() a unit message without a talkgroup.  The unit alias is looked up here, in the trunk-recorder
+  //   thread; the JSON is built by send_event().
+  int send_unit_event(const std::string &type, System *sys, long source_id)
+  {
+    uint64_t mask = get_field_mask(type);
+    Unit_Lookup lookup = lookup_unit(sys, source_id, mask);
+    Json_Builder build = [this, sys, source_id, lookup, mask]
+    { return get_unit_json(sys, source_id, lookup, mask); };
+    return send_event(std::move(build), type, type, topic_unit, true, {sys, 0, source_id});
+  }
+
+  // send_unit_tg_event()
+  //   send_unit_event() for a unit message with a talkgroup.
+  int send_unit_tg_event(const std::string &type, System *sys, long source_id, long talkgroup_num)
+  {
+    uint64_t mask = get_field_mask(type);
+    Unit_Lookup lookup = lookup_unit_tg(sys, source_id, talkgroup_num, mask);
+    Json_Builder build = [this, sys, source_id, talkgroup_num, lookup, mask]
+    { return get_unit_tg_json(sys, source_id, talkgroup_num, lookup, mask); };
+    return send_event(std::move(build), type, type, topic_unit, true, {sys, talkgroup_num, source_id});
+  }
+
   // ********************************
   // trunk-recorder plugin API & startup
   // ********************************
@@ -715,12 +2171,74 @@ public:
     mqtt_password = config_data.value("password", "");
     topic_status = config_data.value("topic", "");
     topic_unit = config_data.value("unit_topic", "");
+    unit_end_batch = (config_data.value("unit_end", "transmission") == "call");
     topic_message = config_data.value("message_topic", "");
     console_enabled = config_data.value("console_logs", false);
+    message_stats_enabled = config_data.value("message_stats", false);
     mqtt_qos = config_data.value("qos", 0);
     mqtt_audio = config_data.value("mqtt_audio", false);
     mqtt_audio_type = config_data.value("mqtt_audio_type", "wav");
+    mqtt_audio_bitrate = config_data.value("mqtt_audio_bitrate", 16);
     mqtt_client_id = config_data.value("client_id", generate_client_id());
+    compress_threshold = config_data.value("compress_threshold", 4096);
+    compress_level = config_data.value("compress_level", Z_DEFAULT_COMPRESSION);
+    compress_suffix = config_data.value("compress_suffix", "/zlib");
+    std::vector<std::string> compress_type_list = config_data.value("compress_types", std::vector<std::string>());
+    compress_types = std::set<std::string>(compress_type_list.begin(), compress_type_list.end());
+    metrics_interval = config_data.value("metrics_interval", 0);
+    rate_rollup_interval = config_data.value("rate_rollup_interval", 0);
+    recorder_stats_interval = config_data.value("recorder_stats_interval", 0);
+    activity_interval = config_data.value("activity_interval", 0);
+    activity_top = config_data.value("activity_top", 10);
+    if (activity_interval > 0)
+    {
+      talkgroup_activity.init(config_data.value("activity_max_talkgroups", 8192));
+      unit_activity.init(config_data.value("activity_max_units", 65536));
+      talkgroup_activity_last.init(config_data.value("activity_max_talkgroups", 8192));
+      unit_activity_last.init(config_data.value("activity_max_units", 65536));
+    }
+    entity_topics = config_data.value("entity_topics", false);
+    calls_resend = config_data.value("calls_resend", true);
+
+    // Periodic publisher intervals; the defaults publish every cycle like earlier versions
+    json intervals_json = config_data.value("publish_intervals", json::object());
+    calls_schedule = parse_schedule(intervals_json, "calls_active", 1);
+    recorders_schedule = parse_schedule(intervals_json, "recorders", 3);
+    rates_schedule = parse_schedule(intervals_json, "rates", 3);
+    timestamp_ms = config_data.value("timestamp_ms", false);
+    serialize_threads = std::max(0, config_data.value("serialize_threads", 0));
+    compile_field_masks(config_data.value("fields", json::object()));
+    compile_topic_templates(config_data.value("topic_templates", json::object()));
+
+    // Overload thresholds for levels 1-3
+    overload_enabled = config_data.contains("overload");
+    json overload_json = config_data.value("overload", json::object());
+    std::vector<int> pending_list = overload_json.value("pending", std::vector<int>({200, 500, 1000}));
+    std::vector<int> latency_list = overload_json.value("latency_ms", std::vector<int>({1000, 3000, 10000}));
+    for (int i = 0; i < 3; i++)
+    {
+      overload_pending[i] = (i < (int)pending_list.size()) ? pending_list[i] : INT_MAX;
+      overload_latency_ms[i] = (i < (int)latency_list.size()) ? latency_list[i] : INT_MAX;
+      overload_dropped[i + 1] = 0;
+    }
+    overload_recover_seconds = overload_json.value("recover_seconds", 30);
+    reconnect_min = std::max(1, config_data.value("reconnect_min", 10));
+    reconnect_max = std::max(reconnect_min, config_data.value("reconnect_max", 40));
+    shutdown_timeout = std::max(0, config_data.value("shutdown_timeout", 5));
+    archive_enabled = config_data.value("archive", false);
+    archive_dir = config_data.value("archive_dir", "");
+    archive_segment_seconds = config_data.value("archive_segment", 3600);
+    archive_block_size = config_data.value("archive_block_size", 262144);
+
+    ipc_shm_name = config_data.value("ipc_shm_name", "");
+    if ((ipc_shm_name != "") && (ipc_shm_name.front() != '/'))
+      ipc_shm_name = "/" + ipc_shm_name;
+    ipc_shm_size = std::max(65536, config_data.value("ipc_shm_size", 4194304));
+
+    // Call ends, unit events, and trunk messages are archived unless a list of message types is given
+    std::vector<std::string> default_archive_types = {"call_end", "call", "end", "on", "off", "ackresp", "join", "data", "ans_req", "location", "message"};
+    std::vector<std::string> archive_type_list = config_data.value("archive_types", default_archive_types);
+    archive_types = std::set<std::string>(archive_type_list.begin(), archive_type_list.end());
 
     // Enable topics and clean up stray '/' if encountered
     if (topic_status != "")
@@ -746,18 +2264,55 @@ public:
     if (console_enabled == true)
       topic_console = topic_status + "/trunk_recorder";
 
+    // Compile the trunk message opcode filters; per-system entries replace the default filter
+    if (config_data.contains("message_filter"))
+    {
+      json filter_json = config_data["message_filter"];
+      message_filter_default = compile_message_filter(filter_json);
+      if (filter_json.contains("systems"))
+      {
+        for (auto &sys_filter : filter_json["systems"].items())
+        {
+          message_filter_named[sys_filter.key()] = compile_message_filter(sys_filter.value());
+        }
+      }
+    }
+
     // Print plugin startup info
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Broker:                 " << mqtt_broker;
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Username:               " << mqtt_username;
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Password:               " << ((mqtt_password == "") ? "[none]" : "********");
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Client ID:              " << mqtt_client_id;
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Status Topic:           " << topic_status;
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Entity Topics:          " << ((entity_topics == false) ? "[disabled]" : topic_status + "/calls/<id>, " + topic_status + "/recorders/<id>");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Active Call Resend:     " << ((calls_resend == false) ? "[disabled]" : schedule_to_str(calls_schedule));
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Recorders Resend:       " << schedule_to_str(recorders_schedule);
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Rates Resend:           " << schedule_to_str(rates_schedule);
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Unit Topic:             " << ((topic_unit == "") ? "[disabled]" : topic_unit + "/shortname");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Unit End Messages:      " << ((unit_end_batch) ? "one per call" : "one per transmission");
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Trunk Message Topic:    " << ((topic_message == "") ? "[disabled]" : topic_message + "/shortname");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Trunk Message Filter:   " << ((config_data.contains("message_filter") == false) ? "[disabled]" : std::to_string(message_filter_default.mask.count()) + " opcodes, " + std::to_string(message_filter_named.size()) + " system overrides");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Rate Rollup Topic:      " << ((rate_rollup_interval <= 0) ? "[disabled]" : topic_status + "/rate_rollup/shortname");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Activity Topic:         " << ((activity_interval <= 0) ? "[disabled]" : topic_status + "/activity/shortname");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Recorder Stats Topic:   " << ((recorder_stats_interval <= 0) ? "[disabled]" : topic_status + "/recorder_stats");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Trunk Message Stats:    " << ((message_stats_enabled == false) ? "[disabled]" : topic_status + "/message_stats");
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Console Message Topic:  " << ((console_enabled == false) ? "[disabled]" : topic_console + "/console");
     BOOST_LOG_TRIVIAL(info) << log_prefix << "MQTT Audio Topic:       " << ((mqtt_audio == false) ? "[disabled]" : topic_status + "/audio");
     BOOST_LOG_TRIVIAL(info) << log_prefix << "MQTT Audio (wav/m4a):   " << ((mqtt_audio == false) ? "[disabled]" : mqtt_audio_type);
+    if ((mqtt_audio == true) && (mqtt_audio_type == "opus"))
+      BOOST_LOG_TRIVIAL(info) << log_prefix << "MQTT Audio Bitrate:     " << mqtt_audio_bitrate << " kbit/s";
     BOOST_LOG_TRIVIAL(info) << log_prefix << "MQTT QOS:               " << mqtt_qos;
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Topic Templates:        " << ((topic_templates.empty()) ? "[none]" : std::to_string(topic_templates.size()) + " message types");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Field Lists:            " << ((field_masks.empty()) ? "[all fields]" : std::to_string(field_masks.size()) + " message types");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Serialize Threads:      " << ((serialize_threads == 0) ? "[disabled]" : std::to_string(serialize_threads));
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Millisecond Timestamps: " << ((timestamp_ms == false) ? "[disabled]" : "event_time, publish_time");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Overload Control:       " << ((overload_enabled == false) ? "[disabled]" : "pending " + std::to_string(overload_pending[0]) + "/" + std::to_string(overload_pending[1]) + "/" + std::to_string(overload_pending[2]) + ", ack latency " + std::to_string(overload_latency_ms[0]) + "/" + std::to_string(overload_latency_ms[1]) + "/" + std::to_string(overload_latency_ms[2]) + " ms");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Reconnect Backoff:      " << reconnect_min << "-" << reconnect_max << " seconds";
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Shutdown Timeout:       " << shutdown_timeout << " seconds";
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Compressed Messages:    " << ((compress_types.empty()) ? "[disabled]" : boost::algorithm::join(compress_types, ", ") + " >= " + std::to_string(compress_threshold) + " bytes");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Plugin Metrics Topic:   " << ((metrics_interval <= 0) ? "[disabled]" : topic_status + "/trunk_recorder/metrics");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Local IPC Ring:         " << ((ipc_shm_name == "") ? "[disabled]" : "/dev/shm" + ipc_shm_name + " (" + std::to_string(ipc_shm_size) + " bytes)");
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Event Archive:          " << ((archive_enabled == false) ? "[disabled]" : ((archive_dir == "") ? "capture_dir/mqtt_archive" : archive_dir));
     return 0;
   }
 
@@ -777,6 +2332,17 @@ public:
     tr_sources = sources;
     tr_systems = systems;
     tr_config = config;
+
+    // Assign each system its compiled trunk message filter
+    for (std::vector<System *>::iterator it = systems.begin(); it != systems.end(); ++it)
+    {
+      System *sys = *it;
+      std::map<std::string, Opcode_Filter>::iterator named = message_filter_named.find(sys->get_short_name());
+      if (named != message_filter_named.end())
+        get_message_filter(sys) = named->second;
+      else
+        get_message_filter(sys);
+    }
     return 0;
   }
 
@@ -785,11 +2351,33 @@ public:
   int start() override
   {
     log_prefix = "[MQTT Status]\t";
-    // Start the MQTT connection
+
+    // Start the local event archive before any messages are sent
+    if (archive_enabled)
+    {
+      if (archive_dir == "")
+        archive_dir = tr_config->capture_dir + "/mqtt_archive";
+      archive_writer.start(archive_dir, archive_segment_seconds, archive_block_size, log_prefix);
+    }
+
+    // Open the local shared memory ring before any messages are sent
+    if ((ipc_shm_name != "") && (!ipc_ring.open(ipc_shm_name, ipc_shm_size)))
+      BOOST_LOG_TRIVIAL(error) << log_prefix << "Unable to open shared memory ring " << ipc_shm_name << ": " << strerror(errno);
+
+    // Start the send shards
+    if (serialize_threads > 0)
+      start_send_shards();
+
+    // Start the Opus audio encoder
+    if ((mqtt_audio) && (mqtt_audio_type == "opus"))
+      start_opus_encoder();
+
+    // Start the MQTT connection; this does not wait for the broker
     open_connection();
-    // Send config and system MQTT messages
+    // Send config and system MQTT messages; these are retained and sent once connected
     send_config(tr_sources, tr_systems);
     setup_systems(tr_systems);
+    send_setup_entities(tr_sources, tr_systems);
 
     // Setup custom logging sink for MQTT messages
     if (console_enabled)
@@ -803,14 +2391,120 @@ public:
     return 0;
   }
 
+  // stop()
+  //   TRUNK-RECORDER PLUGIN API: Called when trunk-recorder is shutting down.
+  //   Refuse new events, then send what is queued in the plugin and in Paho for up to shutdown_timeout seconds.
+  //   The disconnected status is published before a clean disconnect, since the broker only sends the LWT
+  //   when a client goes away without one.
+  //   MQTT: topic/trunk_recorder/status
+  //     retained = true
+  int stop() override
+  {
+    stopping = true;
+    int64_t deadline_ms = steady_ms() + (shutdown_timeout * 1000);
+
+    // Send any calls waiting on the Opus encoder, then messages waiting in the send shards
+    size_t queued = get_opus_queued() + get_send_shard_queued();
+    size_t abandoned = stop_opus_encoder(deadline_ms);
+    abandoned += stop_send_shards(deadline_ms);
+    size_t flushed = queued - abandoned;
+
+    if ((mqtt_client != nullptr) && (mqtt_connected == true))
+    {
+      // Wait for Paho to deliver its buffered messages.  Paho only keeps delivery tokens for QoS 1/2, so at
+      // QoS 0 there is nothing to wait for or count.
+      size_t pending = mqtt_client->get_pending_delivery_tokens().size();
+      size_t remaining = pending;
+      while ((remaining > 0) && (steady_ms() < deadline_ms))
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        remaining = mqtt_client->get_pending_delivery_tokens().size();
+      }
+      flushed += pending - std::min(pending, remaining);
+      abandoned += remaining;
+
+      // Allow the status and disconnect at least a second past the deadline
+      std::chrono::milliseconds wait_time(std::max<int64_t>(deadline_ms - steady_ms(), 1000));
+      // Stop retained messages from being published; the lock is not held while waiting on the broker
+      {
+        std::lock_guard<std::mutex> lock(retained_mutex);
+        mqtt_connected = false;
+      }
+
+      try
+      {
+        mqtt::message_ptr status_msg = mqtt::message_ptr_builder()
+                                           .topic(mqtt_status_topic)
+                                           .payload(mqtt_status_disconnected)
+                                           .qos(mqtt_qos)
+                                           .retained(true)
+                                           .finalize();
+        mqtt_client->publish(status_msg)->wait_for(wait_time);
+        mqtt_client->disconnect((int)wait_time.count())->wait_for(wait_time);
+      }
+      catch (const mqtt::exception &exc)
+      {
+        BOOST_LOG_TRIVIAL(error) << log_prefix << exc.what() << endl;
+      }
+    }
+
+    std::string untracked = (mqtt_qos == 0) ? " (QoS 0 messages buffered by Paho are not tracked)" : "";
+    if (abandoned > 0)
+      BOOST_LOG_TRIVIAL(error) << log_prefix << "Shutdown: sent " << flushed << " queued messages, abandoned " << abandoned << " after " << shutdown_timeout << " seconds" << untracked;
+    else
+      BOOST_LOG_TRIVIAL(info) << log_prefix << "Shutdown: sent " << flushed << " queued messages" << untracked;
+
+    // Flush and close the local event archive
+    archive_writer.stop();
+
+    // Remove the local shared memory ring
+    {
+      std::lock_guard<std::mutex> lock(ipc_mutex);
+      ipc_ring.close();
+    }
+    return 0;
+  }
+
   int setup_config(std::vector<Source *> sources, std::vector<System *> systems) override
   {
     // TRUNK-RECORDER PLUGIN API
     //   Called at the same periodicity of system_rates(), this can be use to accomplish
     //   occasional plugin tasks more efficiently than checking each cycle of poll_one().
 
-    // Refresh recorders every 3 seconds
-    resend_recorders();
+    time_t now_time = time(NULL);
+
+    // Send the systems list if systems were added, and any sources or systems that changed
+    if (systems_dirty)
+      setup_systems(systems);
+    send_setup_entities(sources, systems);
+
+    // Diff talkgroup patches against trunk-recorder and send changes
+    update_patches(systems);
+
+    // Sample recorder states and send utilization summaries
+    if (recorder_stats_interval > 0)
+    {
+      update_recorder_stats();
+      if ((now_time - recorder_stats_time) >= recorder_stats_interval)
+      {
+        send_recorder_stats(now_time - recorder_stats_time);
+        recorder_stats_time = now_time;
+      }
+    }
+
+    // Send talkgroup and unit activity
+    if ((activity_interval > 0) && ((now_time - activity_time) >= activity_interval))
+    {
+      send_activity(now_time - activity_time);
+      activity_time = now_time;
+    }
+
+    // Send plugin metrics
+    if ((metrics_interval > 0) && ((now_time - metrics_time) >= metrics_interval))
+    {
+      send_metrics();
+      metrics_time = now_time;
+    }
     return 0;
   }
 
@@ -818,8 +2512,17 @@ public:
   // TRUNK-RECORDER PLUGIN API: Called during each pass through the main loop of trunk-recorder.
   int poll_one() override
   {
-    // Refresh active calls every 1 second
-    resend_calls();
+    // Retry the broker connection if needed
+    check_connection();
+
+    // Update the overload level once per second
+    if (overload_enabled)
+      check_overload();
+
+    // Refresh active calls and recorders on their schedules
+    if (calls_resend)
+      resend_calls();
+    resend_recorders();
     return 0;
   }
 
@@ -828,9 +2531,13 @@ public:
   // ********************************
 
   // resend_recorders()
-  //   Triggered by setup_config() every 3 seconds to update the status of all recorders.
+  //   Triggered by poll_one() on the recorders schedule (every 3 seconds by default) to update the status of all recorders.
   void resend_recorders()
   {
+    int64_t now_ms = steady_ms();
+    if (!schedule_due(recorders_schedule, now_ms))
+      return;
+
     std::vector<Recorder *> recorders;
     for (std::vector<Source *>::iterator it = tr_sources.begin(); it != tr_sources.end(); ++it)
     {
@@ -838,38 +2545,605 @@ public:
       std::vector<Recorder *> sourceRecorders = source->get_recorders();
       recorders.insert(recorders.end(), sourceRecorders.begin(), sourceRecorders.end());
     }
-    send_recorders(recorders);
+    send_recorders(recorders, now_ms);
   }
 
   // resend_calls()
-  //   Update the active call list once per second when called by poll_one().
+  //   Update the active call list when called by poll_one() on the calls_active schedule (every 1 second by default).
   void resend_calls()
   {
-    time_t now_time = time(NULL);
-    if ((now_time - call_resend_time) >= 1)
+    int64_t now_ms = steady_ms();
+    if (!schedule_due(calls_schedule, now_ms))
+      return;
+
+    nlohmann::ordered_json calls_json = get_calls_json(tr_calls);
+
+    if (entity_topics)
+      send_call_entities(calls_json);
+
+    if (schedule_check(calls_schedule, calls_hash(calls_json), now_ms))
+      send_json(calls_json, "calls", "calls_active", topic_status, false);
+  }
+
+  // update_recorder_stats()
+  //   Credit the time since the last sample to each recorder's current state, and track peak recorders in use.
+  void update_recorder_stats()
+  {
+    int64_t now_ms = steady_ms();
+    double elapsed = (recorder_sample_ms > 0) ? (now_ms - recorder_sample_ms) / 1000.0 : 0;
+    recorder_sample_ms = now_ms;
+
+    std::map<int, int> source_in_use;
+    std::map<std::string, int> type_in_use;
+    std::map<int, int> source_recorders;
+    std::map<std::string, int> type_recorders;
+
+    for (std::vector<Source *>::iterator it = tr_sources.begin(); it != tr_sources.end(); ++it)
+    {
+      Source *source = *it;
+      std::vector<Recorder *> recorders = source->get_recorders();
+      for (std::vector<Recorder *>::iterator rec_it = recorders.begin(); rec_it != recorders.end(); ++rec_it)
+      {
+        Recorder *recorder = *rec_it;
+        int state = recorder->get_state();
+        bool in_use = ((state != AVAILABLE) && (state != STOPPED));
+        std::string type = recorder->get_type_string();
+        Recorder_Usage &source_stats = source_usage[source->get_num()];
+        Recorder_Usage &type_stats = type_usage[type];
+
+        if ((state >= 0) && (state <= 8))
+        {
+          source_stats.state_seconds[state] += elapsed;
+          type_stats.state_seconds[state] += elapsed;
+        }
+
+        source_recorders[source->get_num()]++;
+        type_recorders[type]++;
+        if (in_use)
+        {
+          source_stats.in_use_seconds += elapsed;
+          type_stats.in_use_seconds += elapsed;
+          source_in_use[source->get_num()]++;
+          type_in_use[type]++;
+        }
+      }
+    }
+
+    for (auto &source : source_recorders)
+    {
+      source_usage[source.first].recorders = source.second;
+      source_usage[source.first].peak_in_use = std::max(source_usage[source.first].peak_in_use, source_in_use[source.first]);
+    }
+    for (auto &type : type_recorders)
     {
-      send_calls(tr_calls);
-      call_resend_time = now_time;
+      type_usage[type.first].recorders = type.second;
+      type_usage[type.first].peak_in_use = std::max(type_usage[type.first].peak_in_use, type_in_use[type.first]);
     }
   }
 
-  // int_to_hex()
-  //   Return a hexidecimal value for a given integer, zero-padded for "places"
-  std::string int_to_hex(int num, int places)
+  // get_recorder_usage_json()
+  //   Return a JSON summary of recorder utilization over an interval.
+  nlohmann::ordered_json get_recorder_usage_json(const Recorder_Usage &usage, double interval)
   {
-    std::stringstream stream;
-    stream << std::setfill('0') << std::uppercase << std::setw(places) << std::hex << num;
-    std::string result(stream.str());
-    return result;
+    nlohmann::ordered_json states_json = nlohmann::ordered_json::object();
+    for (std::map<short, std::string>::iterator it = tr_state.begin(); it != tr_state.end(); ++it)
+    {
+      if (usage.state_seconds[it->first] > 0)
+        states_json[it->second] = round_float(usage.state_seconds[it->first]);
+    }
+
+    nlohmann::ordered_json usage_json = {
+        {"recorders", usage.recorders},
+        {"peak_in_use", usage.peak_in_use},
+        {"utilization", round_float((usage.recorders > 0 && interval > 0) ? usage.in_use_seconds / (usage.recorders * interval) : 0)},
+        {"state_seconds", states_json}};
+    return usage_json;
   }
 
-  // generate_client_id()
-  //   Return a unique-enough client_id based on a crc of broker address/topic (tr-status-abcd1234)
-  std::string generate_client_id()
+  // send_recorder_stats()
+  //   Send recorder utilization by source and recorder type, and calls missed for lack of a recorder, then reset them.
+  //   MQTT: topic/recorder_stats
+  int send_recorder_stats(double interval)
   {
-    std::string prefix = "tr-status-";
-    std::string info = mqtt_broker + "/" + topic_status;
-    boost::crc_32_type info_crc;
+    nlohmann::ordered_json stats_json = {{"interval", interval}};
+
+    for (auto &source : source_usage)
+    {
+      nlohmann::ordered_json source_json = {{"src_num", source.first}};
+      source_json.update(get_recorder_usage_json(source.second, interval));
+      stats_json["sources"] += source_json;
+    }
+
+    for (auto &type : type_usage)
+    {
+      nlohmann::ordered_json type_json = {{"type", type.first}};
+      type_json.update(get_recorder_usage_json(type.second, interval));
+      stats_json["types"] += type_json;
+    }
+
+    for (std::vector<System *>::iterator it = tr_systems.begin(); it != tr_systems.end(); ++it)
+    {
+      System *sys = *it;
+      int sys_num = sys->get_sys_num();
+      stats_json["missed_calls"] += {
+          {"sys_num", sys_num},
+          {"sys_name", sys->get_short_name()},
+          {"no_recorder", (sys_num < (int)missed_calls.size()) ? missed_calls[sys_num] : 0}};
+    }
+
+    source_usage.clear();
+    type_usage.clear();
+    missed_calls.clear();
+    return send_json(stats_json, "recorder_stats", "recorder_stats", topic_status, false);
+  }
+
+  // parse_schedule()
+  //   Read { "min": s, "max": s, "heartbeat": s } for a periodic publisher from "publish_intervals".
+  //   Defaults to publishing every default_s seconds; a heartbeat of 0 only publishes on change.
+  Publish_Schedule parse_schedule(json intervals_json, std::string name, double default_s)
+  {
+    json stream_json = intervals_json.value(name, json::object());
+    Publish_Schedule schedule;
+    schedule.min_ms = std::max(100.0, stream_json.value("min", default_s) * 1000);
+    schedule.max_ms = std::max((double)schedule.min_ms, stream_json.value("max", default_s) * 1000);
+    schedule.heartbeat_ms = std::max(0.0, stream_json.value("heartbeat", default_s) * 1000);
+    schedule.interval_ms = schedule.min_ms;
+    return schedule;
+  }
+
+  // schedule_to_str()
+  //   Describe a schedule for the startup log.
+  std::string schedule_to_str(const Publish_Schedule &schedule)
+  {
+    std::stringstream stream;
+    stream << schedule.min_ms / 1000.0 << "-" << schedule.max_ms / 1000.0 << "s, heartbeat ";
+    if (schedule.heartbeat_ms > 0)
+      stream << schedule.heartbeat_ms / 1000.0 << "s";
+    else
+      stream << "[disabled]";
+    return stream.str();
+  }
+
+  // schedule_due()
+  //   True if a periodic publisher should be checked; allows for a little jitter in trunk-recorder's own timers.
+  bool schedule_due(const Publish_Schedule &schedule, int64_t now_ms)
+  {
+    return (now_ms + 250 >= schedule.next_ms);
+  }
+
+  // schedule_check()
+  //   Return true if the payload should be published: it changed, or the heartbeat is due.
+  //   Changes reset the check interval to min; otherwise it backs off toward max.
+  bool schedule_check(Publish_Schedule &schedule, uint64_t hash, int64_t now_ms)
+  {
+    bool changed = (hash != schedule.last_hash);
+    bool heartbeat = ((schedule.heartbeat_ms > 0) && ((now_ms - schedule.last_publish_ms) >= schedule.heartbeat_ms - 250));
+
+    if (changed)
+      schedule.interval_ms = schedule.min_ms;
+    else
+      schedule.interval_ms = std::min(schedule.interval_ms * 2, schedule.max_ms);
+    schedule.next_ms = now_ms + schedule.interval_ms;
+
+    if (changed || heartbeat)
+    {
+      schedule.last_hash = hash;
+      schedule.last_publish_ms = now_ms;
+      return true;
+    }
+    return false;
+  }
+
+  // schedule_sent()
+  //   Record a publish made outside of the schedule (e.g. calls_active() on a call start or end).
+  void schedule_sent(Publish_Schedule &schedule, uint64_t hash, int64_t now_ms)
+  {
+    schedule.last_hash = hash;
+    schedule.last_publish_ms = now_ms;
+    schedule.interval_ms = schedule.min_ms;
+    schedule.next_ms = now_ms + schedule.interval_ms;
+  }
+
+  // calls_hash()
+  //   Hash an active call list, ignoring "elapsed" and "length" which change every second.
+  uint64_t calls_hash(const nlohmann::ordered_json &calls_json)
+  {
+    uint64_t hash = hash_string("");
+    for (auto &call_json : calls_json)
+    {
+      nlohmann::ordered_json compare_json = call_json;
+      compare_json.erase("elapsed");
+      compare_json.erase("length");
+      hash = hash_string(compare_json.dump(), hash);
+    }
+    return hash;
+  }
+
+  // hash_string()
+  //   64-bit FNV-1a hash, optionally continuing from a previous hash.
+  static uint64_t hash_string(const std::string &input, uint64_t hash = 14695981039346656037ULL)
+  {
+    for (unsigned char c : input)
+    {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  // opcode_index()
+  //   Clamp a trunking message opcode into the 256 entry filter/lookup tables; unknown opcodes map to 0xff.
+  int opcode_index(int opcode)
+  {
+    if ((opcode < 0) || (opcode > 0xff) || (opcode_type.find(opcode) == opcode_type.end()))
+      return 0xff;
+    return opcode;
+  }
+
+  // opcode_from_str()
+  //   Return the opcode for a mnemonic from opcode_type ("IDEN_UP") or a hex string ("0x3d"); -1 if not found.
+  //   Hex opcodes outside opcode_type are rejected, since those messages are filtered as "UNK" (0xff).
+  int opcode_from_str(const std::string &name)
+  {
+    for (auto &opcode : opcode_type)
+    {
+      if (opcode.second[0] == name)
+        return opcode.first;
+    }
+
+    if ((name.size() > 2) && (name[0] == '0') && ((name[1] == 'x') || (name[1] == 'X')))
+    {
+      char *end;
+      long opcode = strtol(name.c_str() + 2, &end, 16);
+      if ((*end == '\0') && (opcode >= 0) && (opcode <= 0xff) && (opcode_type.find(opcode) != opcode_type.end()))
+        return opcode;
+    }
+    return -1;
+  }
+
+  // compile_message_filter()
+  //   Build an Opcode_Filter from a "message_filter" config object:
+  //     "include"       <- only publish these opcodes
+  //     "exclude"       <- never publish these opcodes
+  //     "sample"        <- { "OPCODE": N } publish 1-in-N messages
+  //     "min_interval"  <- { "OPCODE": seconds } minimum time between messages
+  Opcode_Filter compile_message_filter(json filter_json)
+  {
+    Opcode_Filter filter;
+
+    if (filter_json.contains("include"))
+    {
+      filter.mask.reset();
+      for (auto &name : filter_json["include"])
+      {
+        int opcode = opcode_from_str(name.get<std::string>());
+        if (opcode >= 0)
+          filter.mask.set(opcode);
+        else
+          BOOST_LOG_TRIVIAL(error) << log_prefix << "Unknown opcode in message_filter include: " << name.get<std::string>();
+      }
+    }
+
+    if (filter_json.contains("exclude"))
+    {
+      for (auto &name : filter_json["exclude"])
+      {
+        int opcode = opcode_from_str(name.get<std::string>());
+        if (opcode >= 0)
+          filter.mask.reset(opcode);
+        else
+          BOOST_LOG_TRIVIAL(error) << log_prefix << "Unknown opcode in message_filter exclude: " << name.get<std::string>();
+      }
+    }
+
+    if (filter_json.contains("sample"))
+    {
+      for (auto &sample : filter_json["sample"].items())
+      {
+        int opcode = opcode_from_str(sample.key());
+        if (opcode >= 0)
+          filter.sample_n[opcode] = std::max(1, sample.value().get<int>());
+        else
+          BOOST_LOG_TRIVIAL(error) << log_prefix << "Unknown opcode in message_filter sample: " << sample.key();
+      }
+    }
+
+    if (filter_json.contains("min_interval"))
+    {
+      for (auto &interval : filter_json["min_interval"].items())
+      {
+        int opcode = opcode_from_str(interval.key());
+        if (opcode >= 0)
+          filter.min_interval[opcode] = std::max(0, interval.value().get<int>());
+        else
+          BOOST_LOG_TRIVIAL(error) << log_prefix << "Unknown opcode in message_filter min_interval: " << interval.key();
+      }
+    }
+
+    return filter;
+  }
+
+  // message_type_index()
+  //   Return the Message_Stats slot for a trunking message type; UNKNOWN and unlisted types share the last slot.
+  int message_type_index(int type)
+  {
+    if ((type < 0) || (type > 15))
+      return 16;
+    return type;
+  }
+
+  // get_message_stats()
+  //   Return the trunk message counters for a system.
+  Message_Stats &get_message_stats(System *sys)
+  {
+    int sys_num = sys->get_sys_num();
+    if (sys_num >= (int)message_stats.size())
+      message_stats.resize(sys_num + 1);
+    return message_stats[sys_num];
+  }
+
+  // get_message_filter()
+  //   Return the trunk message filter for a system.
+  Opcode_Filter &get_message_filter(System *sys)
+  {
+    int sys_num = sys->get_sys_num();
+    if (sys_num >= (int)message_filters.size())
+      message_filters.resize(sys_num + 1, message_filter_default);
+    return message_filters[sys_num];
+  }
+
+  // message_filter_pass()
+  //   Apply the opcode mask, 1-in-N sampling, and minimum interval throttling for a trunk message.
+  bool message_filter_pass(System *sys, int opcode)
+  {
+    Opcode_Filter &filter = get_message_filter(sys);
+
+    if (!filter.mask.test(opcode))
+      return false;
+
+    if (filter.sample_n[opcode] > 1)
+    {
+      if (filter.sample_count[opcode]++ % filter.sample_n[opcode] != 0)
+        return false;
+    }
+
+    if (filter.min_interval[opcode] > 0)
+    {
+      time_t now_time = time(NULL);
+      if ((now_time - filter.last_sent[opcode]) < filter.min_interval[opcode])
+        return false;
+      filter.last_sent[opcode] = now_time;
+    }
+    return true;
+  }
+
+  // add_call_activity()
+  //   Count a completed call and its transmissions in the talkgroup and unit activity tables.
+  //   Transmissions without a unit (source 0) count toward the talkgroup, but not as a unit.
+  void add_call_activity(const Call_Data_t &call_info)
+  {
+    std::lock_guard<std::mutex> lock(activity_mutex);
+    Talkgroup_Activity *talkgroup = talkgroup_activity.find_or_insert(Activity_Table<Talkgroup_Activity>::make_key(call_info.sys_num, call_info.talkgroup));
+    if (talkgroup != nullptr)
+    {
+      talkgroup->calls++;
+      talkgroup->transmissions += call_info.transmission_list.size();
+      talkgroup->airtime += call_info.length;
+      if (call_info.emergency)
+        talkgroup->emergencies++;
+      if (call_info.encrypted)
+        talkgroup->encrypted++;
+    }
+
+    for (size_t transmission_num = 0; transmission_num < call_info.transmission_list.size(); transmission_num++)
+    {
+      const Transmission &transmission = call_info.transmission_list[transmission_num];
+      bool emergency = ((transmission_num < call_info.transmission_source_list.size()) && (call_info.transmission_source_list[transmission_num].emergency));
+      if (transmission.source == 0)
+        continue;
+      if (talkgroup != nullptr)
+        talkgroup->units.add(transmission.source);
+
+      Unit_Activity *unit = unit_activity.find_or_insert(Activity_Table<Unit_Activity>::make_key(call_info.sys_num, transmission.source));
+      if (unit == nullptr)
+        continue;
+      if (unit->last_call_num != call_info.call_num)
+      {
+        unit->calls++;
+        unit->last_call_num = call_info.call_num;
+      }
+      unit->transmissions++;
+      unit->airtime += transmission.length;
+      if (emergency)
+        unit->emergencies++;
+    }
+  }
+
+  // send_activity()
+  //   Send each system's talkgroup and unit activity for the interval, then start a new interval.
+  //   Talkgroups and units are ranked by airtime; "units" on a talkgroup is an estimate.
+  //   MQTT: topic/activity/<short_name>
+  //     retained = true; totals, top talkgroups, and top units
+  //   MQTT: topic/activity/<short_name>/talkgroups
+  //     retained = true; every talkgroup heard in the interval
+  void send_activity(double interval)
+  {
+    typedef std::pair<uint32_t, const Talkgroup_Activity *> Talkgroup_Entry;
+    typedef std::pair<uint32_t, const Unit_Activity *> Unit_Entry;
+    std::map<int, std::vector<Talkgroup_Entry>> talkgroups;
+    std::map<int, std::vector<Unit_Entry>> units;
+
+    // Start the next interval, so call_end() is not held up while this one is sent
+    {
+      std::lock_guard<std::mutex> lock(activity_mutex);
+      std::swap(talkgroup_activity, talkgroup_activity_last);
+      std::swap(unit_activity, unit_activity_last);
+    }
+
+    for (std::vector<Activity_Table<Talkgroup_Activity>::Slot>::const_iterator it = talkgroup_activity_last.slots.begin(); it != talkgroup_activity_last.slots.end(); ++it)
+    {
+      if (it->key != 0)
+        talkgroups[(it->key >> 32) - 1].push_back(Talkgroup_Entry((uint32_t)it->key, &it->value));
+    }
+    for (std::vector<Activity_Table<Unit_Activity>::Slot>::const_iterator it = unit_activity_last.slots.begin(); it != unit_activity_last.slots.end(); ++it)
+    {
+      if (it->key != 0)
+        units[(it->key >> 32) - 1].push_back(Unit_Entry((uint32_t)it->key, &it->value));
+    }
+
+    for (std::vector<System *>::iterator sys_it = tr_systems.begin(); sys_it != tr_systems.end(); ++sys_it)
+    {
+      System *sys = *sys_it;
+      std::vector<Talkgroup_Entry> &sys_talkgroups = talkgroups[sys->get_sys_num()];
+      std::vector<Unit_Entry> &sys_units = units[sys->get_sys_num()];
+
+      std::sort(sys_talkgroups.begin(), sys_talkgroups.end(), [](const Talkgroup_Entry &a, const Talkgroup_Entry &b)
+                { return a.second->airtime > b.second->airtime; });
+      size_t top_units = std::min(sys_units.size(), (size_t)std::max(0, activity_top));
+      std::partial_sort(sys_units.begin(), sys_units.begin() + top_units, sys_units.end(), [](const Unit_Entry &a, const Unit_Entry &b)
+                        { return a.second->airtime > b.second->airtime; });
+
+      uint32_t calls = 0;
+      uint32_t emergencies = 0;
+      double airtime = 0;
+      nlohmann::ordered_json talkgroups_json = nlohmann::ordered_json::array();
+      for (std::vector<Talkgroup_Entry>::iterator it = sys_talkgroups.begin(); it != sys_talkgroups.end(); ++it)
+      {
+        calls += it->second->calls;
+        emergencies += it->second->emergencies;
+        airtime += it->second->airtime;
+
+        Talkgroup *tg = sys->find_talkgroup(it->first);
+        talkgroups_json += {
+            {"talkgroup", it->first},
+            {"talkgroup_alpha_tag", (tg != NULL) ? tg->alpha_tag : ""},
+            {"calls", it->second->calls},
+            {"transmissions", it->second->transmissions},
+            {"airtime", round_float(it->second->airtime)},
+            {"emergencies", it->second->emergencies},
+            {"encrypted", it->second->encrypted},
+            {"units", it->second->units.estimate()}};
+      }
+
+      nlohmann::ordered_json top_talkgroups_json = nlohmann::ordered_json::array();
+      for (size_t i = 0; (i < talkgroups_json.size()) && ((int)i < activity_top); i++)
+        top_talkgroups_json += talkgroups_json[i];
+
+      nlohmann::ordered_json top_units_json = nlohmann::ordered_json::array();
+      for (size_t i = 0; i < top_units; i++)
+      {
+        top_units_json += {
+            {"unit", sys_units[i].first},
+            {"unit_alpha_tag", sys->find_unit_tag(sys_units[i].first)},
+            {"calls", sys_units[i].second->calls},
+            {"transmissions", sys_units[i].second->transmissions},
+            {"airtime", round_float(sys_units[i].second->airtime)},
+            {"emergencies", sys_units[i].second->emergencies}};
+      }
+
+      nlohmann::ordered_json activity_json = {
+          {"sys_num", sys->get_sys_num()},
+          {"sys_name", sys->get_short_name()},
+          {"interval", round_float(interval)},
+          {"calls", calls},
+          {"airtime", round_float(airtime)},
+          {"emergencies", emergencies},
+          {"talkgroups", sys_talkgroups.size()},
+          {"units", sys_units.size()},
+          {"top_talkgroups", top_talkgroups_json},
+          {"top_units", top_units_json}};
+      send_json_topic(activity_json, "activity", "activity", topic_status + "/activity/" + sys->get_short_name(), true);
+
+      nlohmann::ordered_json talkgroup_list_json = {
+          {"sys_num", sys->get_sys_num()},
+          {"sys_name", sys->get_short_name()},
+          {"interval", round_float(interval)},
+          {"talkgroups", talkgroups_json}};
+      send_json_topic(talkgroup_list_json, "activity", "talkgroup_activity", topic_status + "/activity/" + sys->get_short_name() + "/talkgroups", true);
+    }
+
+    if ((talkgroup_activity_last.overflow > 0) || (unit_activity_last.overflow > 0))
+      BOOST_LOG_TRIVIAL(error) << log_prefix << "Activity tables full; talkgroups not counted: " << talkgroup_activity_last.overflow << " units not counted: " << unit_activity_last.overflow;
+
+    talkgroup_activity_last.clear();
+    unit_activity_last.clear();
+  }
+
+  // send_metrics()
+  //   Send plugin counters; totals since startup.
+  //   MQTT: topic/trunk_recorder/metrics
+  int send_metrics()
+  {
+    uint64_t bytes_in = metrics.compress_bytes_in;
+    uint64_t bytes_out = metrics.compress_bytes_out;
+
+    nlohmann::ordered_json metrics_json = {
+        {"client_id", mqtt_client_id},
+        {"compression", {
+            {"messages", metrics.compressed_messages.load()},
+            {"bytes_in", bytes_in},
+            {"bytes_out", bytes_out},
+            {"ratio", round_float((bytes_out > 0) ? (double)bytes_in / bytes_out : 0)},
+            {"cpu_ms", round_float(metrics.compress_cpu_ns / 1e6)}}}};
+
+    if (mqtt_qos > 0)
+      metrics_json["delivery"] = get_delivery_json();
+
+    if (!send_shards.empty())
+    {
+      size_t queued = 0;
+      for (std::vector<std::unique_ptr<Send_Shard>>::iterator it = send_shards.begin(); it != send_shards.end(); ++it)
+      {
+        std::lock_guard<std::mutex> lock((*it)->mutex);
+        queued += (*it)->queue.size();
+      }
+      metrics_json["send_shards"] = {{"threads", send_shards.size()}, {"queued", queued}, {"dropped", send_shard_dropped.load()}};
+    }
+
+    if (overload_enabled)
+      metrics_json["overload"] = {{"level", overload_level.load()}, {"dropped", get_overload_dropped_json()}};
+
+    return send_json(metrics_json, "metrics", "metrics", topic_status + "/trunk_recorder", false);
+  }
+
+  // compress_payload()
+  //   zlib compress a payload in place and record the ratio and thread CPU time.  Returns false if left uncompressed.
+  bool compress_payload(std::string &payload)
+  {
+    struct timespec cpu_start, cpu_end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+
+    std::string compressed;
+    if (!zlib_compress(payload, compressed, compress_level, false))
+      return false;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+    metrics.compressed_messages++;
+    metrics.compress_bytes_in += payload.size();
+    metrics.compress_bytes_out += compressed.size();
+    metrics.compress_cpu_ns += (cpu_end.tv_sec - cpu_start.tv_sec) * 1000000000LL + (cpu_end.tv_nsec - cpu_start.tv_nsec);
+
+    payload.swap(compressed);
+    return true;
+  }
+
+  // int_to_hex()
+  //   Return a hexidecimal value for a given integer, zero-padded for "places"
+  std::string int_to_hex(int num, int places)
+  {
+    std::stringstream stream;
+    stream << std::setfill('0') << std::uppercase << std::setw(places) << std::hex << num;
+    std::string result(stream.str());
+    return result;
+  }
+
+  // generate_client_id()
+  //   Return a unique-enough client_id based on a crc of broker address/topic (tr-status-abcd1234)
+  std::string generate_client_id()
+  {
+    std::string prefix = "tr-status-";
+    std::string info = mqtt_broker + "/" + topic_status;
+    boost::crc_32_type info_crc;
     info_crc.process_bytes(info.data(), info.length());
 
     std::stringstream stream;
@@ -887,6 +3161,26 @@ public:
     return std::regex_replace(std::regex_replace(input, escape_seq_regex, ""), tab_regex, "    ");
   }
 
+  // zlib_compress()
+  //   Deflate a buffer into a zlib stream, or a gzip member if gzip = true.  Returns false on failure.
+  static bool zlib_compress(const std::string &input, std::string &output, int level, bool gzip)
+  {
+    z_stream stream = {};
+    if (deflateInit2(&stream, level, Z_DEFLATED, gzip ? (MAX_WBITS + 16) : MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return false;
+
+    output.resize(deflateBound(&stream, input.size()) + 32);
+    stream.next_in = (Bytef *)input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef *)&output[0];
+    stream.avail_out = output.size();
+
+    int ret = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return (ret == Z_STREAM_END);
+  }
+
   // round_float()
   //   Round a float to two decimal places and return it as as double.
   //   "position", "length", and "duration" are the usual offenders.
@@ -912,6 +3206,117 @@ public:
     return patch_string;
   }
 
+  // get_patch_table()
+  //   Return the patch table of a system.  The caller holds patch_mutex.
+  Patch_Table &get_patch_table(int sys_num)
+  {
+    if (sys_num >= (int)patch_tables.size())
+      patch_tables.resize(sys_num + 1);
+    return patch_tables[sys_num];
+  }
+
+  // get_patch_str()
+  //   Return the precomputed "talkgroup_patches" string for a talkgroup, or "" if it is not patched.
+  //   Returned by value, since update_patches() may rebuild the table once the lock is released.
+  std::string get_patch_str(int sys_num, unsigned long talkgroup_num)
+  {
+    std::lock_guard<std::mutex> lock(patch_mutex);
+    if (sys_num >= (int)patch_tables.size())
+      return "";
+    std::map<unsigned long, std::string>::iterator it = patch_tables[sys_num].patch_str.find(talkgroup_num);
+    return (it == patch_tables[sys_num].patch_str.end()) ? "" : it->second;
+  }
+
+  // update_patches()
+  //   Ask trunk-recorder for the patches of each talkgroup that was patched or seen in a patch message, and
+  //   send an event for each patch added or removed.  trunk-recorder also expires stale patches, so known
+  //   patches are checked on every update.
+  //   MQTT: topic/patch_add
+  //   MQTT: topic/patch_delete
+  //   MQTT: topic/patches/<short_name>
+  //     retained = true; sent when the system's patches change
+  void update_patches(std::vector<System *> systems)
+  {
+    for (std::vector<System *>::iterator it = systems.begin(); it != systems.end(); ++it)
+    {
+      System *sys = *it;
+      std::set<unsigned long> check_tgs;
+      std::map<unsigned long, std::vector<unsigned long>> old_members;
+      {
+        std::lock_guard<std::mutex> lock(patch_mutex);
+        Patch_Table &table = get_patch_table(sys->get_sys_num());
+        if ((table.touched.empty()) && (table.members.empty()))
+          continue;
+        check_tgs.swap(table.touched);
+        old_members = table.members;
+      }
+
+      for (std::map<unsigned long, std::vector<unsigned long>>::iterator tg = old_members.begin(); tg != old_members.end(); ++tg)
+        check_tgs.insert(tg->first);
+
+      std::map<unsigned long, std::vector<unsigned long>> members;
+      for (std::set<unsigned long>::iterator tg = check_tgs.begin(); tg != check_tgs.end(); ++tg)
+      {
+        if (members.find(*tg) != members.end())
+          continue;
+        std::vector<unsigned long> patch = sys->get_talkgroup_patch(*tg);
+        for (std::vector<unsigned long>::iterator member = patch.begin(); member != patch.end(); ++member)
+          members[*member] = patch;
+      }
+
+      if (members == old_members)
+        continue;
+
+      std::set<std::vector<unsigned long>> old_patches;
+      std::set<std::vector<unsigned long>> new_patches;
+      for (std::map<unsigned long, std::vector<unsigned long>>::iterator tg = old_members.begin(); tg != old_members.end(); ++tg)
+        old_patches.insert(tg->second);
+      for (std::map<unsigned long, std::vector<unsigned long>>::iterator tg = members.begin(); tg != members.end(); ++tg)
+        new_patches.insert(tg->second);
+
+      for (std::set<std::vector<unsigned long>>::iterator patch = new_patches.begin(); patch != new_patches.end(); ++patch)
+      {
+        if (old_patches.find(*patch) == old_patches.end())
+          send_json(get_patch_json(sys, *patch), "patch", "patch_add", topic_status, false);
+      }
+      for (std::set<std::vector<unsigned long>>::iterator patch = old_patches.begin(); patch != old_patches.end(); ++patch)
+      {
+        if (new_patches.find(*patch) == new_patches.end())
+          send_json(get_patch_json(sys, *patch), "patch", "patch_delete", topic_status, false);
+      }
+
+      std::map<unsigned long, std::string> patch_str;
+      for (std::map<unsigned long, std::vector<unsigned long>>::iterator tg = members.begin(); tg != members.end(); ++tg)
+        patch_str[tg->first] = patches_to_str(tg->second);
+      {
+        std::lock_guard<std::mutex> lock(patch_mutex);
+        Patch_Table &table = get_patch_table(sys->get_sys_num());
+        table.members = members;
+        table.patch_str.swap(patch_str);
+      }
+
+      nlohmann::ordered_json patches_json = {
+          {"sys_num", sys->get_sys_num()},
+          {"sys_name", sys->get_short_name()},
+          {"patches", nlohmann::ordered_json::array()}};
+      for (std::set<std::vector<unsigned long>>::iterator patch = new_patches.begin(); patch != new_patches.end(); ++patch)
+        patches_json["patches"] += *patch;
+      send_json_topic(patches_json, "patches", "patches", topic_status + "/patches/" + sys->get_short_name(), true);
+    }
+  }
+
+  // get_patch_json()
+  //   Return a JSON object for a patch event.
+  nlohmann::ordered_json get_patch_json(System *sys, const std::vector<unsigned long> &patch)
+  {
+    nlohmann::ordered_json patch_json = {
+        {"sys_num", sys->get_sys_num()},
+        {"sys_name", sys->get_short_name()},
+        {"talkgroups", patch},
+        {"talkgroup_patches", patches_to_str(patch)}};
+    return patch_json;
+  }
+
   // find_system()
   //   Find a system by its id number and return a pointer.
   System *find_system(int sys_num)
@@ -919,148 +3324,318 @@ public:
     return tr_systems[sys_num];
   }
 
+  // compile_field_masks()
+  //   Compile the "fields" config object ({ "message type": ["field", ...] }) to a bitmask per message type.
+  //   "id" is always kept for calls and recorders, since it names their entity topics.
+  void compile_field_masks(const json &fields_json)
+  {
+    field_masks.clear();
+    for (json::const_iterator it = fields_json.begin(); it != fields_json.end(); ++it)
+    {
+      const std::string &type = it.key();
+      const std::vector<std::string> *table;
+      uint64_t mask = 0;
+
+      if ((type == "calls_active") || (type == "call_start") || (type == "call_end"))
+      {
+        table = &call_fields;
+        mask = field_bit(CALL_ID);
+      }
+      else if ((type == "recorders") || (type == "recorder"))
+      {
+        table = &recorder_fields;
+        mask = field_bit(REC_ID);
+      }
+      else if ((type == "systems") || (type == "system"))
+        table = &system_fields;
+      else if ((type == "call") || (type == "end") || (type == "on") || (type == "off") || (type == "ackresp") ||
+               (type == "join") || (type == "data") || (type == "ans_req") || (type == "location"))
+        table = &unit_fields;
+      else
+      {
+        BOOST_LOG_TRIVIAL(error) << log_prefix << "Field list for unknown message type ignored: " << type;
+        continue;
+      }
+
+      std::vector<std::string> names = it.value().get<std::vector<std::string>>();
+      for (std::vector<std::string>::iterator name = names.begin(); name != names.end(); ++name)
+      {
+        std::vector<std::string>::const_iterator field = std::find(table->begin(), table->end(), *name);
+        if (field == table->end())
+          BOOST_LOG_TRIVIAL(error) << log_prefix << "Unknown field for " << type << " ignored: " << *name;
+        else
+          mask |= field_bit(field - table->begin());
+      }
+      field_masks[type] = mask;
+    }
+  }
+
+  // get_field_mask()
+  //   Return the fields to send for a message type.
+  uint64_t get_field_mask(const std::string &type)
+  {
+    std::map<std::string, uint64_t>::iterator it = field_masks.find(type);
+    return (it == field_masks.end()) ? all_fields : it->second;
+  }
+
+  static uint64_t field_bit(int field)
+  {
+    return (1ULL << field);
+  }
+
+  static bool has_field(uint64_t mask, int field)
+  {
+    return ((mask >> field) & 1);
+  }
+
   // get_recorder_json()
   //   Return a JSON object for a recorder.
-  nlohmann::ordered_json get_recorder_json(Recorder *recorder)
-  {
-    boost::property_tree::ptree stat_node = recorder->get_stats();
-
-    nlohmann::ordered_json recorder_json = {
-        {"id", stat_node.get<std::string>("id")},
-        {"src_num", stat_node.get<int>("srcNum")},
-        {"rec_num", stat_node.get<int>("recNum")},
-        {"type", stat_node.get<std::string>("type")},
-        {"duration", round_float(stat_node.get<double>("duration"))},
-        {"freq", recorder->get_freq()},
-        {"count", stat_node.get<int>("count")},
-        {"rec_state", stat_node.get<int>("state")},
-        {"rec_state_type", tr_state[stat_node.get<int>("state")]},
-        {"squelched", recorder->is_squelched()}};
+  //   Fields are read from the recorder's getters; get_stats() is only used for "count" and "duration", which have none.
+  nlohmann::ordered_json get_recorder_json(Recorder *recorder, uint64_t mask = all_fields)
+  {
+    nlohmann::ordered_json recorder_json = nlohmann::ordered_json::object();
+    int src_num = recorder->get_source()->get_num();
+    int rec_num = recorder->get_num();
+    int rec_state = recorder->get_state();
+
+    boost::property_tree::ptree stat_node;
+    if (has_field(mask, REC_DURATION) || has_field(mask, REC_COUNT))
+      stat_node = recorder->get_stats();
+
+    if (has_field(mask, REC_ID))
+      recorder_json["id"] = std::to_string(src_num) + "_" + std::to_string(rec_num);
+    if (has_field(mask, REC_SRC_NUM))
+      recorder_json["src_num"] = src_num;
+    if (has_field(mask, REC_REC_NUM))
+      recorder_json["rec_num"] = rec_num;
+    if (has_field(mask, REC_TYPE))
+      recorder_json["type"] = recorder->get_type_string();
+    if (has_field(mask, REC_DURATION))
+      recorder_json["duration"] = round_float(stat_node.get<double>("duration"));
+    if (has_field(mask, REC_FREQ))
+      recorder_json["freq"] = recorder->get_freq();
+    if (has_field(mask, REC_COUNT))
+      recorder_json["count"] = stat_node.get<int>("count");
+    if (has_field(mask, REC_REC_STATE))
+      recorder_json["rec_state"] = rec_state;
+    if (has_field(mask, REC_REC_STATE_TYPE))
+      recorder_json["rec_state_type"] = tr_state[rec_state];
+    if (has_field(mask, REC_SQUELCHED))
+      recorder_json["squelched"] = recorder->is_squelched();
     return recorder_json;
   }
 
   // get_call_json()
-  //   Return a JSON object for a call.
-  nlohmann::ordered_json get_call_json(Call *call)
+  //   Return a JSON object for a call, read from the call's getters rather than get_stats().
+  nlohmann::ordered_json get_call_json(Call *call, uint64_t mask = all_fields)
   {
-    boost::property_tree::ptree stat_node = call->get_stats();
-    json talkgroup_json = get_tg_json(call->get_system(), stat_node.get<int>("talkgroup"));
-
-    nlohmann::ordered_json call_json = {
-        {"id", stat_node.get<std::string>("id")},
-        {"call_num", stat_node.get<long>("callNum")},
-        {"sys_num", stat_node.get<int>("sysNum")},
-        {"sys_name", stat_node.get<std::string>("shortName")},
-        {"freq", stat_node.get<double>("freq")},
-        {"unit", stat_node.get<long>("srcId")},
-        {"unit_alpha_tag", call->get_system()->find_unit_tag(stat_node.get<long>("srcId"))},
-        {"talkgroup", stat_node.get<int>("talkgroup")},
-        {"talkgroup_alpha_tag", talkgroup_json["talkgroup_alpha_tag"]},
-        {"talkgroup_description", talkgroup_json["talkgroup_description"]},
-        {"talkgroup_group", talkgroup_json["talkgroup_group"]},
-        {"talkgroup_tag", talkgroup_json["talkgroup_tag"]},
-        {"talkgroup_patches", talkgroup_json["talkgroup_patches"]},
-        {"elapsed", stat_node.get<long>("elapsed")},
-        {"length", round_float(stat_node.get<double>("length"))},
-        {"call_state", stat_node.get<int>("state")},
-        {"call_state_type", tr_state[stat_node.get<int>("state")]},
-        {"mon_state", stat_node.get<int>("monState")},
-        {"mon_state_type", mon_state[stat_node.get<int>("monState")]},
-        {"audio_type", "digital"},
-        {"phase2_tdma", stat_node.get<bool>("phase2")},
-        {"tdma_slot", call->get_tdma_slot()},
-        {"analog", stat_node.get<bool>("analog", false)},
-        {"rec_num", stat_node.get<int>("recNum", -1)},
-        {"src_num", stat_node.get<int>("srcNum", -1)},
-        {"rec_state", stat_node.get<int>("recState", -1)},
-        {"rec_state_type", tr_state[stat_node.get<int>("recState", -1)]},
-        {"conventional", stat_node.get<bool>("conventional")},
-        {"encrypted", stat_node.get<bool>("encrypted")},
-        {"emergency", stat_node.get<bool>("emergency")},
-        {"start_time", stat_node.get<long>("startTime")},
-        {"stop_time", stat_node.get<long>("stopTime")}};
-
-    if (call->get_is_analog())
-      call_json["audio_type"] = "analog";
-    else if (call->get_phase2_tdma())
-      call_json["audio_type"] = "digital tdma";
+    nlohmann::ordered_json call_json = nlohmann::ordered_json::object();
+    long source_id = call->get_current_source_id();
+    long start_time = call->get_start_time();
+    int call_state = call->get_state();
+    int call_mon_state = call->get_monitoring_state();
+
+    // Recorder details are only known while a recorder is assigned
+    Recorder *recorder = call->get_recorder();
+    bool analog = false;
+    int rec_num = -1;
+    int src_num = -1;
+    int rec_state = -1;
+    if (recorder != NULL)
+    {
+      analog = recorder->is_analog();
+      rec_num = recorder->get_num();
+      src_num = recorder->get_source()->get_num();
+      rec_state = recorder->get_state();
+    }
 
+    if (has_field(mask, CALL_ID))
+      call_json["id"] = std::to_string(call->get_sys_num()) + "_" + std::to_string(call->get_talkgroup()) + "_" + std::to_string(start_time);
+    if (has_field(mask, CALL_CALL_NUM))
+      call_json["call_num"] = call->get_call_num();
+    if (has_field(mask, CALL_SYS_NUM))
+      call_json["sys_num"] = call->get_sys_num();
+    if (has_field(mask, CALL_SYS_NAME))
+      call_json["sys_name"] = call->get_short_name();
+    if (has_field(mask, CALL_FREQ))
+      call_json["freq"] = call->get_freq();
+    if (has_field(mask, CALL_UNIT))
+      call_json["unit"] = source_id;
+    if (has_field(mask, CALL_UNIT_ALPHA_TAG))
+      call_json["unit_alpha_tag"] = call->get_system()->find_unit_tag(source_id);
+    add_talkgroup_json(call_json, call->get_system(), call->get_talkgroup(), mask >> CALL_TALKGROUP);
+    if (has_field(mask, CALL_ELAPSED))
+      call_json["elapsed"] = time(NULL) - start_time;
+    if (has_field(mask, CALL_LENGTH))
+      call_json["length"] = round_float(call->get_current_length());
+    if (has_field(mask, CALL_CALL_STATE))
+      call_json["call_state"] = call_state;
+    if (has_field(mask, CALL_CALL_STATE_TYPE))
+      call_json["call_state_type"] = tr_state[call_state];
+    if (has_field(mask, CALL_MON_STATE))
+      call_json["mon_state"] = call_mon_state;
+    if (has_field(mask, CALL_MON_STATE_TYPE))
+      call_json["mon_state_type"] = mon_state[call_mon_state];
+    if (has_field(mask, CALL_AUDIO_TYPE))
+    {
+      if (call->get_is_analog())
+        call_json["audio_type"] = "analog";
+      else if (call->get_phase2_tdma())
+        call_json["audio_type"] = "digital tdma";
+      else
+        call_json["audio_type"] = "digital";
+    }
+    if (has_field(mask, CALL_PHASE2_TDMA))
+      call_json["phase2_tdma"] = call->get_phase2_tdma();
+    if (has_field(mask, CALL_TDMA_SLOT))
+      call_json["tdma_slot"] = call->get_tdma_slot();
+    if (has_field(mask, CALL_ANALOG))
+      call_json["analog"] = analog;
+    if (has_field(mask, CALL_REC_NUM))
+      call_json["rec_num"] = rec_num;
+    if (has_field(mask, CALL_SRC_NUM))
+      call_json["src_num"] = src_num;
+    if (has_field(mask, CALL_REC_STATE))
+      call_json["rec_state"] = rec_state;
+    if (has_field(mask, CALL_REC_STATE_TYPE))
+      call_json["rec_state_type"] = tr_state[rec_state];
+    if (has_field(mask, CALL_CONVENTIONAL))
+      call_json["conventional"] = call->is_conventional();
+    if (has_field(mask, CALL_ENCRYPTED))
+      call_json["encrypted"] = call->get_encrypted();
+    if (has_field(mask, CALL_EMERGENCY))
+      call_json["emergency"] = call->get_emergency();
+    if (has_field(mask, CALL_START_TIME))
+      call_json["start_time"] = start_time;
+    if (has_field(mask, CALL_STOP_TIME))
+      call_json["stop_time"] = call->get_stop_time();
     return call_json;
   }
 
   // get_system_json()
-  //   Return a JSON object for a system.
-  nlohmann::ordered_json get_system_json(System *sys)
+  //   Return a JSON object for a system, read from the system's getters rather than get_stats().
+  nlohmann::ordered_json get_system_json(System *sys, uint64_t mask = all_fields)
   {
-    boost::property_tree::ptree stat_node = sys->get_stats();
-
-    nlohmann::ordered_json system_json = {
-        {"sys_num", stat_node.get<int>("id")},
-        {"sys_name", stat_node.get<std::string>("name")},
-        {"type", stat_node.get<std::string>("type")},
-        {"sysid", int_to_hex(stat_node.get<int>("sysid"), 0)},
-        {"wacn", int_to_hex(stat_node.get<int>("wacn"), 0)},
-        {"nac", int_to_hex(stat_node.get<int>("nac"), 0)},
-        {"rfss", sys->get_sys_rfss()},
-        {"site_id", sys->get_sys_site_id()}};
+    nlohmann::ordered_json system_json = nlohmann::ordered_json::object();
+
+    if (has_field(mask, SYS_SYS_NUM))
+      system_json["sys_num"] = sys->get_sys_num();
+    if (has_field(mask, SYS_SYS_NAME))
+      system_json["sys_name"] = sys->get_short_name();
+    if (has_field(mask, SYS_TYPE))
+      system_json["type"] = sys->get_system_type();
+    if (has_field(mask, SYS_SYSID))
+      system_json["sysid"] = int_to_hex(sys->get_sys_id(), 0);
+    if (has_field(mask, SYS_WACN))
+      system_json["wacn"] = int_to_hex(sys->get_wacn(), 0);
+    if (has_field(mask, SYS_NAC))
+      system_json["nac"] = int_to_hex(sys->get_nac(), 0);
+    if (has_field(mask, SYS_RFSS))
+      system_json["rfss"] = sys->get_sys_rfss();
+    if (has_field(mask, SYS_SITE_ID))
+      system_json["site_id"] = sys->get_sys_site_id();
     return system_json;
   }
 
   // get_unit_json()
   //   Return a JSON object for a unit message WITHOUT a known talkgroup.
-  nlohmann::ordered_json get_unit_json(System *sys, long source_id)
+  nlohmann::ordered_json get_unit_json(System *sys, long source_id, uint64_t mask = all_fields)
   {
-    nlohmann::ordered_json unit_json = {
-        {"sys_num", sys->get_sys_num()},
-        {"sys_name", sys->get_short_name()},
-        {"unit", source_id},
-        {"unit_alpha_tag", sys->find_unit_tag(source_id)}};
+    return get_unit_json(sys, source_id, lookup_unit(sys, source_id, mask), mask);
+  }
+
+  nlohmann::ordered_json get_unit_json(System *sys, long source_id, const Unit_Lookup &lookup, uint64_t mask)
+  {
+    nlohmann::ordered_json unit_json = nlohmann::ordered_json::object();
+
+    if (has_field(mask, UNIT_SYS_NUM))
+      unit_json["sys_num"] = sys->get_sys_num();
+    if (has_field(mask, UNIT_SYS_NAME))
+      unit_json["sys_name"] = sys->get_short_name();
+    if (has_field(mask, UNIT_UNIT))
+      unit_json["unit"] = source_id;
+    if (has_field(mask, UNIT_UNIT_ALPHA_TAG))
+      unit_json["unit_alpha_tag"] = lookup.unit_alpha_tag;
     return unit_json;
   }
 
   // get_unit_tg_json()
   //   Return a JSON object for a unit message WITH a known talkgroup.
-  nlohmann::ordered_json get_unit_tg_json(System *sys, long source_id, long talkgroup_num)
+  nlohmann::ordered_json get_unit_tg_json(System *sys, long source_id, long talkgroup_num, uint64_t mask = all_fields)
   {
-    json tg_json = get_tg_json(sys, talkgroup_num);
+    return get_unit_tg_json(sys, source_id, talkgroup_num, lookup_unit_tg(sys, source_id, talkgroup_num, mask), mask);
+  }
 
-    nlohmann::ordered_json unit_tg_json = {
-        {"sys_num", sys->get_sys_num()},
-        {"sys_name", sys->get_short_name()},
-        {"unit", source_id},
-        {"unit_alpha_tag", sys->find_unit_tag(source_id)},
-        {"talkgroup", talkgroup_num},
-        {"talkgroup_alpha_tag", tg_json["talkgroup_alpha_tag"]},
-        {"talkgroup_description", tg_json["talkgroup_description"]},
-        {"talkgroup_group", tg_json["talkgroup_group"]},
-        {"talkgroup_tag", tg_json["talkgroup_tag"]},
-        {"talkgroup_patches", tg_json["talkgroup_patches"]}};
+  nlohmann::ordered_json get_unit_tg_json(System *sys, long source_id, long talkgroup_num, const Unit_Lookup &lookup, uint64_t mask)
+  {
+    nlohmann::ordered_json unit_tg_json = get_unit_json(sys, source_id, lookup, mask);
+    add_talkgroup_json(unit_tg_json, talkgroup_num, lookup.talkgroup, mask >> UNIT_TALKGROUP);
     return unit_tg_json;
   }
 
-  // get_tg_json()
-  //   Return a JSON object for talkgroup and patches. Returns "" if TG meta is not found.
-  json get_tg_json(System *sys, long talkgroup_num)
+  // lookup_unit()
+  //   Look up the unit alias for a unit message, if it is sent.
+  Unit_Lookup lookup_unit(System *sys, long source_id, uint64_t mask)
   {
-    Talkgroup *tg = sys->find_talkgroup(talkgroup_num);
-    std::string patch_string = patches_to_str(sys->get_talkgroup_patch(talkgroup_num));
+    Unit_Lookup lookup;
+    if (has_field(mask, UNIT_UNIT_ALPHA_TAG))
+      lookup.unit_alpha_tag = sys->find_unit_tag(source_id);
+    return lookup;
+  }
 
-    json tg_json = {
-        {"talkgroup", talkgroup_num},
-        {"talkgroup_alpha_tag", ""},
-        {"talkgroup_description", ""},
-        {"talkgroup_group", ""},
-        {"talkgroup_tag", ""},
-        {"talkgroup_patches", patch_string}};
+  // lookup_unit_tg()
+  //   lookup_unit(), and the talkgroup and its patches, if they are sent.
+  Unit_Lookup lookup_unit_tg(System *sys, long source_id, long talkgroup_num, uint64_t mask)
+  {
+    Unit_Lookup lookup = lookup_unit(sys, source_id, mask);
+    lookup.talkgroup = lookup_talkgroup(sys, talkgroup_num, mask >> UNIT_TALKGROUP);
+    return lookup;
+  }
 
-    if (tg != NULL)
+  // lookup_talkgroup()
+  //   Copy the talkgroup metadata and patches that are sent; tg_mask is the field mask shifted to "talkgroup".
+  //   Metadata is "" if the talkgroup is not found, and is not looked up unless one of its fields is sent.
+  Talkgroup_Lookup lookup_talkgroup(System *sys, long talkgroup_num, uint64_t tg_mask)
+  {
+    Talkgroup_Lookup lookup;
+    if (tg_mask & 0x1e)
     {
-      tg_json["talkgroup_alpha_tag"] = tg->alpha_tag;
-      tg_json["talkgroup_description"] = tg->description;
-      tg_json["talkgroup_group"] = tg->group;
-      tg_json["talkgroup_tag"] = tg->tag;
+      Talkgroup *tg = sys->find_talkgroup(talkgroup_num);
+      if (tg != NULL)
+      {
+        lookup.alpha_tag = tg->alpha_tag;
+        lookup.description = tg->description;
+        lookup.group = tg->group;
+        lookup.tag = tg->tag;
+      }
     }
-    return tg_json;
+    if (has_field(tg_mask, 5))
+      lookup.patches = get_patch_str(sys->get_sys_num(), talkgroup_num);
+    return lookup;
+  }
+
+  // add_talkgroup_json()
+  //   Add the talkgroup number, metadata, and patches to a JSON object.  The six talkgroup fields are
+  //   consecutive in the call and unit field tables; tg_mask is the field mask shifted to "talkgroup".
+  void add_talkgroup_json(nlohmann::ordered_json &json_obj, System *sys, long talkgroup_num, uint64_t tg_mask)
+  {
+    add_talkgroup_json(json_obj, talkgroup_num, lookup_talkgroup(sys, talkgroup_num, tg_mask), tg_mask);
+  }
+
+  void add_talkgroup_json(nlohmann::ordered_json &json_obj, long talkgroup_num, const Talkgroup_Lookup &lookup, uint64_t tg_mask)
+  {
+    if (has_field(tg_mask, 0))
+      json_obj["talkgroup"] = talkgroup_num;
+    if (has_field(tg_mask, 1))
+      json_obj["talkgroup_alpha_tag"] = lookup.alpha_tag;
+    if (has_field(tg_mask, 2))
+      json_obj["talkgroup_description"] = lookup.description;
+    if (has_field(tg_mask, 3))
+      json_obj["talkgroup_group"] = lookup.group;
+    if (has_field(tg_mask, 4))
+      json_obj["talkgroup_tag"] = lookup.tag;
+    if (has_field(tg_mask, 5))
+      json_obj["talkgroup_patches"] = lookup.patches;
   }
 
   std::string file_to_base64(const std::string& filename) {
@@ -1084,6 +3659,21 @@ public:
     return base64_str;
   }
 
+  // shell_quote()
+  //   Single quote a path for use in a shell command.
+  std::string shell_quote(const std::string &input)
+  {
+    std::string quoted = "'";
+    for (char c : input)
+    {
+      if (c == '\'')
+        quoted += "'\\''";
+      else
+        quoted += c;
+    }
+    return quoted + "'";
+  }
+
   std::string get_filename_from_path(const std::string& path) {
     const char* filename = strrchr(path.c_str(), '/');
     if (!filename)
@@ -1096,29 +3686,24 @@ public:
   // ********************************
 
   // open_connection()
-  //   Open the connection to the destination MQTT server using paho libraries.
-  //   Send a status message on connect/disconnect.
-  //   MQTT: topic_message/status/trunk_recorder/status
+  //   Start a connection to the destination MQTT server using paho libraries without waiting for it.
+  //   connected() sends the status message and any retained messages once the broker is reached;
+  //   poll_one() retries failed connections with a jittered backoff.
+  //   MQTT: topic/trunk_recorder/status
   void open_connection()
   {
     // Set a connect/disconnect message between client and broker
-    std::string topic_lwt = topic_status + "/trunk_recorder/status";
+    mqtt_status_topic = topic_status + "/trunk_recorder/status";
 
     json status_msg = {
         {"status", "connected"},
         {"instance_id", tr_instance_id},
         {"client_id", mqtt_client_id}};
-
-    mqtt::message_ptr conn_msg = mqtt::message_ptr_builder()
-                                     .topic(topic_lwt)
-                                     .payload(status_msg.dump())
-                                     .qos(mqtt_qos)
-                                     .retained(true)
-                                     .finalize();
+    mqtt_status_connected = status_msg.dump();
 
     status_msg["status"] = "disconnected";
-    std::string lwt_json = status_msg.dump();
-    auto will_msg = mqtt::message(topic_lwt, lwt_json.c_str(), strlen(lwt_json.c_str()), mqtt_qos, true);
+    mqtt_status_disconnected = status_msg.dump();
+    auto will_msg = mqtt::message(mqtt_status_topic, mqtt_status_disconnected.c_str(), mqtt_status_disconnected.size(), mqtt_qos, true);
 
     // Set SSL options
     mqtt::ssl_options sslopts = mqtt::ssl_options_builder()
@@ -1126,35 +3711,38 @@ public:
                                     .enable_server_cert_auth(false)
                                     .finalize();
 
-    // Set connection options
-    mqtt::connect_options connOpts = mqtt::connect_options_builder()
-                                         .clean_session()
-                                         .ssl(sslopts)
-                                         .automatic_reconnect(std::chrono::seconds(10), std::chrono::seconds(40))
-                                         .will(will_msg)
-                                         .finalize();
+    // Set connection options; reconnects are handled by poll_one()
+    mqtt_conn_opts = mqtt::connect_options_builder()
+                         .clean_session()
+                         .ssl(sslopts)
+                         .automatic_reconnect(false)
+                         .will(will_msg)
+                         .finalize();
 
     // Set user/pass if indicated
     if ((mqtt_username != "") && (mqtt_password != ""))
     {
       BOOST_LOG_TRIVIAL(info) << log_prefix << "Setting MQTT Broker username and password..." << endl;
-      connOpts.set_user_name(mqtt_username);
-      connOpts.set_password(mqtt_password);
+      mqtt_conn_opts.set_user_name(mqtt_username);
+      mqtt_conn_opts.set_password(mqtt_password);
     }
 
-    // Open a connection to the broker, set mqtt_connected true if successful, publish a connect message
     mqtt_client = new mqtt::async_client(mqtt_broker, mqtt_client_id, tr_config->capture_dir + "/store");
     mqtt_client->set_callback(*this);
 
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Connecting...";
+    reconnect_backoff = reconnect_min;
+    connect_broker();
+  }
+
+  // connect_broker()
+  //   Begin an asynchronous connection attempt and schedule the next retry in case it fails.
+  void connect_broker()
+  {
+    schedule_reconnect();
     try
     {
-      BOOST_LOG_TRIVIAL(info) << log_prefix << "Connecting...";
-      mqtt::token_ptr conntok = mqtt_client->connect(connOpts);
-      BOOST_LOG_TRIVIAL(info) << log_prefix << "Waiting for the connection...";
-      conntok->wait();
-      // BOOST_LOG_TRIVIAL(info) << log_prefix << "OK";
-      // mqtt_connected = true;
-      mqtt_client->publish(conn_msg);
+      mqtt_conn_token = mqtt_client->connect(mqtt_conn_opts);
     }
     catch (const mqtt::exception &exc)
     {
@@ -1162,19 +3750,463 @@ public:
     }
   }
 
+  // schedule_reconnect()
+  //   Set the next connection attempt to a random time between 1/2 and 1 times the current backoff,
+  //   then double the backoff up to reconnect_max.
+  void schedule_reconnect()
+  {
+    int backoff = reconnect_backoff;
+    std::uniform_int_distribution<int64_t> jitter(backoff * 500, backoff * 1000);
+    reconnect_time_ms = steady_ms() + jitter(reconnect_rng);
+    reconnect_backoff = std::min(backoff * 2, reconnect_max);
+  }
+
+  // check_connection()
+  //   Called by poll_one(); retry the broker connection once the backoff has passed and no attempt is pending.
+  void check_connection()
+  {
+    if ((mqtt_client == nullptr) || (mqtt_connected == true) || (stopping == true))
+      return;
+
+    if (reconnect_time_ms < 0)
+    {
+      schedule_reconnect();
+      return;
+    }
+
+    if (steady_ms() < reconnect_time_ms)
+      return;
+
+    if ((mqtt_conn_token) && (!mqtt_conn_token->is_complete()))
+      return;
+
+    BOOST_LOG_TRIVIAL(info) << log_prefix << "Reconnecting to broker: " << mqtt_broker;
+    connect_broker();
+  }
+
+  // check_overload()
+  //   Compare the messages Paho has not finished sending and the average ack latency to the overload thresholds.
+  //   Raise the level at once; lower it one level at a time after recover_seconds below half of the level's thresholds.
+  //   Publish errors (e.g. Paho's buffer is full) raise the level by one.
+  //   MQTT: topic/trunk_recorder/overload
+  //     retained = true; sent when the level changes
+  void check_overload()
+  {
+    int64_t now_ms = steady_ms();
+    if ((mqtt_client == nullptr) || ((now_ms - overload_check_ms) < 1000))
+      return;
+    overload_check_ms = now_ms;
+
+    size_t pending = std::max<int64_t>(publish_listener.outstanding, 0);
+    double latency;
+    {
+      std::lock_guard<std::mutex> lock(delivery_mutex);
+      latency = ack_ms_average;
+    }
+
+    int level = overload_level;
+    int target = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      if ((pending >= (size_t)overload_pending[i]) || (latency >= overload_latency_ms[i]))
+        target = i + 1;
+    }
+    if (overload_publish_errors.exchange(0) > 0)
+      target = std::max(target, std::min(level + 1, 3));
+
+    int new_level = level;
+    if (target > level)
+    {
+      new_level = target;
+      overload_recover_ms = 0;
+    }
+    else if (level > 0)
+    {
+      bool recovered = ((pending < (size_t)overload_pending[level - 1] / 2) && (latency < overload_latency_ms[level - 1] / 2));
+      if (!recovered)
+        overload_recover_ms = 0;
+      else if (overload_recover_ms == 0)
+        overload_recover_ms = now_ms;
+      else if ((now_ms - overload_recover_ms) >= overload_recover_seconds * 1000)
+      {
+        new_level = level - 1;
+        overload_recover_ms = 0;
+      }
+    }
+
+    if (new_level != level)
+    {
+      overload_level = new_level;
+      // Shedding is logged as a warning, or an error at the top level; recovery is informational
+      std::stringstream overload_log;
+      overload_log << log_prefix << "Overload level " << level << " -> " << new_level << " - pending: " << pending << " ack latency: " << round_float(latency) << " ms";
+      if (new_level < level)
+        BOOST_LOG_TRIVIAL(info) << overload_log.str();
+      else if (new_level < 3)
+        BOOST_LOG_TRIVIAL(warning) << overload_log.str();
+      else
+        BOOST_LOG_TRIVIAL(error) << overload_log.str();
+
+      nlohmann::ordered_json overload_json = {
+          {"level", new_level},
+          {"previous_level", level},
+          {"pending", pending},
+          {"ack_ms_average", round_float(latency)},
+          {"dropped", get_overload_dropped_json()}};
+      send_json(overload_json, "overload", "overload", topic_status + "/trunk_recorder", true);
+    }
+  }
+
+  // get_overload_dropped_json()
+  //   Return the count of messages shed at each tier since startup.
+  nlohmann::ordered_json get_overload_dropped_json()
+  {
+    nlohmann::ordered_json dropped_json = {
+        {"tier_1", overload_dropped[1].load()},
+        {"tier_2", overload_dropped[2].load()},
+        {"tier_3", overload_dropped[3].load()}};
+    return dropped_json;
+  }
+
+  // steady_ms()
+  //   Monotonic milliseconds for timers.
+  static int64_t steady_ms()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
   // send_json()
   //   Send a MQTT message using the configured connection and paho libraries.
+  //   Retained messages are kept and republished each time the broker connection is made.
   //   send_json(
   //      json data                         <- json payload,
   //      std::string name                  <- json payload name,
   //      std::string type                  <- subtopic / message type
   //      std::string object_topic          <- topic base,
   //      bool retained                     <- retain message at the broker (config, system, etc.)
+  //      int64_t event_ms                  <- optional time of the trunk-recorder event (ms since epoch)
   //      )
-  int send_json(nlohmann::ordered_json data, std::string name, std::string type, std::string object_topic, bool retained)
+  int send_json(nlohmann::ordered_json data, std::string name, std::string type, std::string object_topic, bool retained, int64_t event_ms = 0)
   {
-    // Ignore requests to send MQTT messages before the connection is opened
-    if (mqtt_connected == false)
+    if (stopping)
+      return 0;
+    return send_json_topic(data, name, type, object_topic + "/" + type, retained, event_ms);
+  }
+
+  // send_event()
+  //   send_json() a message about a system, talkgroup, or unit.  If the message type has a topic template, the
+  //   topic is rendered from it; otherwise it is topic_base/type, or topic_base/shortname/type when per_system.
+  //   With serialize_threads, the rest of the work is handed to the system's send shard.
+  int send_event(const nlohmann::ordered_json &data, const std::string &name, const std::string &type, const std::string &topic_base, bool per_system, const Topic_Values &values, int64_t event_ms = 0)
+  {
+    if (stopping)
+      return 0;
+
+    const std::string &topic = get_event_topic(type, topic_base, per_system, values);
+    if ((!send_shards.empty()) && (values.sys != NULL))
+      return queue_send(values.sys->get_sys_num(), {data, nullptr, name, type, topic, event_ms});
+    return send_json_topic(data, name, type, topic, false, event_ms);
+  }
+
+  // send_event()
+  //   send_event() a message built by build(), on the system's send shard with serialize_threads.  build() may
+  //   run on another thread, so it should only use what it captured by value and the System.
+  int send_event(Json_Builder build, const std::string &name, const std::string &type, const std::string &topic_base, bool per_system, const Topic_Values &values, int64_t event_ms = 0)
+  {
+    if (stopping)
+      return 0;
+
+    const std::string &topic = get_event_topic(type, topic_base, per_system, values);
+    if ((!send_shards.empty()) && (values.sys != NULL))
+      return queue_send(values.sys->get_sys_num(), {nlohmann::ordered_json(), std::move(build), name, type, topic, event_ms});
+    return send_json_topic(build(), name, type, topic, false, event_ms);
+  }
+
+  // get_event_topic()
+  //   Return the topic of a send_event() message, rendered into a per-thread buffer; the Opus thread also sends
+  //   messages.
+  const std::string &get_event_topic(const std::string &type, const std::string &topic_base, bool per_system, const Topic_Values &values)
+  {
+    static thread_local std::string topic;
+    std::map<std::string, std::vector<Topic_Segment>>::const_iterator it = topic_templates.find(type);
+    if (it != topic_templates.end())
+      render_topic(it->second, type, values, topic);
+    else
+    {
+      topic.assign(topic_base);
+      if (per_system)
+      {
+        topic += '/';
+        topic += values.sys->get_short_name();
+      }
+      topic += '/';
+      topic += type;
+    }
+    return topic;
+  }
+
+  // queue_send()
+  //   Queue a message for the send shard of a system.  Messages for one system are always sent in order by the
+  //   same worker; a full queue drops the message rather than block trunk-recorder.
+  int queue_send(int sys_num, Send_Job job)
+  {
+    Send_Shard &shard = *send_shards[sys_num % send_shards.size()];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if ((!shard.running) || (shard.queue.size() >= send_shard_max))
+    {
+      send_shard_dropped++;
+      return 1;
+    }
+    shard.queue.push_back(std::move(job));
+    shard.cv.notify_one();
+    return 0;
+  }
+
+  // start_send_shards()
+  //   Start serialize_threads workers to dump, compress, archive, and publish messages about systems.
+  void start_send_shards()
+  {
+    for (int i = 0; i < serialize_threads; i++)
+    {
+      send_shards.emplace_back(new Send_Shard());
+      Send_Shard *shard = send_shards.back().get();
+      shard->running = true;
+      shard->thread = std::thread(&Mqtt_Status::send_shard_loop, this, shard);
+    }
+  }
+
+  // stop_send_shards()
+  //   Send the queued messages and join the workers.  Messages still queued at deadline_ms (steady_ms(), 0 for
+  //   none) are abandoned; returns how many.
+  size_t stop_send_shards(int64_t deadline_ms = 0)
+  {
+    std::vector<Send_Shard *> stopped;
+    for (std::vector<std::unique_ptr<Send_Shard>>::iterator it = send_shards.begin(); it != send_shards.end(); ++it)
+    {
+      Send_Shard &shard = **it;
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (!shard.running)
+        continue;
+      shard.running = false;
+      shard.cv.notify_one();
+      stopped.push_back(&shard);
+    }
+
+    size_t abandoned = 0;
+    if (deadline_ms > 0)
+    {
+      while ((get_send_shard_queued() > 0) && (steady_ms() < deadline_ms))
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+      for (std::vector<Send_Shard *>::iterator it = stopped.begin(); it != stopped.end(); ++it)
+      {
+        std::lock_guard<std::mutex> lock((*it)->mutex);
+        abandoned += (*it)->queue.size();
+        (*it)->queue.clear();
+      }
+    }
+
+    for (std::vector<Send_Shard *>::iterator it = stopped.begin(); it != stopped.end(); ++it)
+      (*it)->thread.join();
+    return abandoned;
+  }
+
+  size_t get_send_shard_queued()
+  {
+    size_t queued = 0;
+    for (std::vector<std::unique_ptr<Send_Shard>>::iterator it = send_shards.begin(); it != send_shards.end(); ++it)
+    {
+      std::lock_guard<std::mutex> lock((*it)->mutex);
+      queued += (*it)->queue.size();
+    }
+    return queued;
+  }
+
+  void send_shard_loop(Send_Shard *shard)
+  {
+    while (true)
+    {
+      Send_Job job;
+      {
+        std::unique_lock<std::mutex> lock(shard->mutex);
+        shard->cv.wait(lock, [shard]
+                       { return !shard->queue.empty() || !shard->running; });
+        if (shard->queue.empty())
+          return;
+        job = std::move(shard->queue.front());
+        shard->queue.pop_front();
+      }
+      if (job.build)
+        job.data = job.build();
+      send_json_topic(job.data, job.name, job.type, job.topic, false, job.event_ms);
+    }
+  }
+
+  // compile_topic_templates()
+  //   Compile the "topic_templates" config object ({ "message type": "template" }).  "unit" sets the template
+  //   for every unit message type without its own.
+  void compile_topic_templates(const json &templates_json)
+  {
+    const std::vector<std::string> template_types = {
+        "call_start", "call_end", "message", "call", "end", "on", "off", "ackresp", "join", "data", "ans_req", "location"};
+    const std::vector<std::string> unit_types = {
+        "call", "end", "on", "off", "ackresp", "join", "data", "ans_req", "location"};
+
+    topic_templates.clear();
+    for (json::const_iterator it = templates_json.begin(); it != templates_json.end(); ++it)
+    {
+      const std::string &type = it.key();
+      if ((type != "unit") && (std::find(template_types.begin(), template_types.end(), type) == template_types.end()))
+      {
+        BOOST_LOG_TRIVIAL(error) << log_prefix << "Topic template for unknown message type ignored: " << type;
+        continue;
+      }
+
+      if (!it.value().is_string() || it.value().get<std::string>().empty())
+      {
+        BOOST_LOG_TRIVIAL(error) << log_prefix << "Topic template for " << type << " ignored, the template must be a non-empty string";
+        continue;
+      }
+
+      std::vector<Topic_Segment> segments;
+      if (!compile_topic_template(it.value().get<std::string>(), segments))
+        continue;
+
+      if (type == "unit")
+      {
+        for (std::vector<std::string>::const_iterator unit_type = unit_types.begin(); unit_type != unit_types.end(); ++unit_type)
+        {
+          if (!templates_json.contains(*unit_type))
+            topic_templates[*unit_type] = segments;
+        }
+      }
+      else
+        topic_templates[type] = segments;
+    }
+  }
+
+  // compile_topic_template()
+  //   Split a topic template into literal and placeholder segments.  Returns false for an unknown or unclosed placeholder.
+  bool compile_topic_template(const std::string &topic_template, std::vector<Topic_Segment> &segments)
+  {
+    size_t pos = 0;
+    while (pos < topic_template.size())
+    {
+      size_t open = topic_template.find('{', pos);
+      if (open != pos)
+      {
+        segments.push_back({TOPIC_LITERAL, topic_template.substr(pos, open - pos)});
+        if (open == std::string::npos)
+          break;
+      }
+
+      size_t close = topic_template.find('}', open);
+      if (close == std::string::npos)
+      {
+        BOOST_LOG_TRIVIAL(error) << log_prefix << "Topic template ignored, missing '}': " << topic_template;
+        return false;
+      }
+
+      std::map<std::string, Topic_Field>::const_iterator field = topic_placeholders.find(topic_template.substr(open + 1, close - open - 1));
+      if (field == topic_placeholders.end())
+      {
+        BOOST_LOG_TRIVIAL(error) << log_prefix << "Topic template ignored, unknown placeholder " << topic_template.substr(open, close - open + 1) << ": " << topic_template;
+        return false;
+      }
+      segments.push_back({field->second, ""});
+      pos = close + 1;
+    }
+    return true;
+  }
+
+  // render_topic()
+  //   Render a compiled topic template into topic, reusing its buffer.  Placeholders without a value for the
+  //   message (e.g. {talkgroup} for "on") render as topic_empty_value, so the topic keeps its levels and never has "//".
+  void render_topic(const std::vector<Topic_Segment> &segments, const std::string &type, const Topic_Values &values, std::string &topic)
+  {
+    topic.clear();
+    for (std::vector<Topic_Segment>::const_iterator it = segments.begin(); it != segments.end(); ++it)
+    {
+      switch (it->field)
+      {
+      case TOPIC_LITERAL:
+        topic += it->literal;
+        break;
+      case TOPIC_BASE:
+        topic += topic_status;
+        break;
+      case TOPIC_UNIT_BASE:
+        topic += topic_unit;
+        break;
+      case TOPIC_MESSAGE_BASE:
+        topic += topic_message;
+        break;
+      case TOPIC_INSTANCE_ID:
+        topic += tr_instance_id.empty() ? topic_empty_value : tr_instance_id;
+        break;
+      case TOPIC_SYS_NAME:
+        if ((values.sys != NULL) && !values.sys->get_short_name().empty())
+          topic += values.sys->get_short_name();
+        else
+          topic += topic_empty_value;
+        break;
+      case TOPIC_SYS_NUM:
+        if (values.sys != NULL)
+          append_number(topic, values.sys->get_sys_num());
+        else
+          topic += topic_empty_value;
+        break;
+      case TOPIC_TALKGROUP:
+        if (values.talkgroup != 0)
+          append_number(topic, values.talkgroup);
+        else
+          topic += topic_empty_value;
+        break;
+      case TOPIC_UNIT:
+        if (values.unit != 0)
+          append_number(topic, values.unit);
+        else
+          topic += topic_empty_value;
+        break;
+      case TOPIC_TYPE:
+        topic += type;
+        break;
+      }
+    }
+  }
+
+  static void append_number(std::string &out, long num)
+  {
+    char buffer[24];
+    std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), num);
+    out.append(buffer, result.ptr);
+  }
+
+  // send_json_topic()
+  //   send_json() to a complete topic, instead of a topic base + type.
+  int send_json_topic(const nlohmann::ordered_json &data, const std::string &name, const std::string &type, const std::string &topic, bool retained, int64_t event_ms = 0)
+  {
+    int64_t publish_ms = system_ms();
+    if (event_ms == 0)
+      event_ms = publish_ms;
+
+    // Shed lower priority messages while the broker is overloaded; retained messages are always kept
+    bool shed = false;
+    if ((overload_level > 0) && (retained == false))
+    {
+      std::map<std::string, int>::iterator tier = overload_tiers.find(type);
+      if ((tier != overload_tiers.end()) && (tier->second <= overload_level))
+      {
+        overload_dropped[tier->second]++;
+        shed = true;
+      }
+    }
+
+    bool archive = (archive_enabled && (archive_types.find(type) != archive_types.end()));
+    bool ipc = ipc_ring.is_open();
+
+    // Ignore requests to send MQTT messages before the connection is opened; they may still be archived, retained, or sent to the local ring
+    if (((mqtt_connected == false) || (shed == true)) && (archive == false) && (retained == false) && (ipc == false))
       return 0;
 
     // Assemble the MQTT message
@@ -1184,26 +4216,168 @@ public:
         {"timestamp", time(NULL)},
         {"instance_id", tr_instance_id}};
 
+    if (timestamp_ms)
+    {
+      payload["event_time"] = event_ms;
+      payload["publish_time"] = publish_ms;
+    }
+
+    std::string payload_str = payload.dump();
+
+    if (archive)
+      archive_writer.write(topic, payload_str);
+
+    if (ipc)
+      ipc_write(topic, payload_str);
+
+    if (((mqtt_connected == false) || (shed == true)) && (retained == false))
+      return 0;
+
+    // Compress large messages of the selected types; the topic suffix marks the payload as zlib
+    bool compressed = false;
+    if ((payload_str.size() >= (size_t)compress_threshold) && (compress_types.find(type) != compress_types.end()))
+      compressed = compress_payload(payload_str);
+    std::string compressed_topic;
+    if (compressed)
+      compressed_topic = topic + compress_suffix;
+    const std::string &publish_topic = compressed ? compressed_topic : topic;
+
+    if (retained)
+    {
+      std::lock_guard<std::mutex> lock(retained_mutex);
+
+      // A retained message may change size across compress_threshold; clear the other topic so subscribers
+      // do not see both versions
+      if (!compress_types.empty())
+      {
+        std::string other_topic = compressed ? topic : topic + compress_suffix;
+        if (retained_cache.find(other_topic) != retained_cache.end())
+          clear_retained_topic(other_topic);
+      }
+
+      retained_cache[publish_topic] = payload_str;
+      retained_cleared.erase(publish_topic);
+      if (mqtt_connected == false)
+        return 0;
+      return publish_message(publish_topic, payload_str, true, type, event_ms);
+    }
+
+    return publish_message(publish_topic, payload_str, false, type, event_ms);
+  }
+
+  // clear_retained()
+  //   Remove a retained message from the broker with an empty payload, and stop republishing it.
+  int clear_retained(const std::string &topic)
+  {
+    if (ipc_ring.is_open())
+      ipc_write(topic, "");
+
+    std::lock_guard<std::mutex> lock(retained_mutex);
+    return clear_retained_topic(topic);
+  }
+
+  // clear_retained_topic()
+  //   clear_retained() for a caller that holds retained_mutex.  While disconnected the topic is remembered,
+  //   so connected() can remove it from the broker.
+  int clear_retained_topic(const std::string &topic)
+  {
+    retained_cache.erase(topic);
+    if (mqtt_connected == false)
+    {
+      retained_cleared.insert(topic);
+      return 0;
+    }
+    return publish_message(topic, "", true);
+  }
+
+  // ipc_write()
+  //   Copy a message to the local shared memory ring.  Messages are sent from more than one thread, so the
+  //   ring's single writer is serialized here; readers never take this lock.
+  void ipc_write(const std::string &topic, const std::string &payload)
+  {
+    std::lock_guard<std::mutex> lock(ipc_mutex);
+    if ((ipc_ring.is_open()) && (ipc_ring.write(topic, payload) == 0))
+      BOOST_LOG_TRIVIAL(debug) << log_prefix << "Message too large for shared memory ring: " << topic << " " << payload.size() << " bytes";
+  }
+
+  // publish_message()
+  //   Publish a finished payload to a topic.  QoS 1/2 messages are tracked until delivery_complete().
+  int publish_message(const std::string &topic, const std::string &payload, bool retained, std::string type = "", int64_t event_ms = 0)
+  {
     mqtt::message_ptr pubmsg = mqtt::message_ptr_builder()
-                                   .topic(object_topic + "/" + type)
-                                   .payload(payload.dump())
+                                   .topic(topic)
+                                   .payload(payload)
                                    .qos(mqtt_qos)
                                    .retained(retained)
                                    .finalize();
 
-    // Publish the MQTT message
+    // Track the message before publishing, since the ack may arrive before publish() returns
+    bool track = (mqtt_qos > 0);
+    if (track)
+    {
+      int64_t now_ms = system_ms();
+      std::lock_guard<std::mutex> lock(delivery_mutex);
+      in_flight[pubmsg.get()] = {type.empty() ? "other" : type, now_ms, (event_ms > 0) ? event_ms : now_ms};
+    }
+
+    // Publish the MQTT message; publish_listener counts it until Paho has sent (QoS 0) or delivered (QoS 1/2) it
+    publish_listener.outstanding++;
     try
     {
-      mqtt_client->publish(pubmsg);
+      mqtt_client->publish(pubmsg, nullptr, publish_listener);
     }
     catch (const mqtt::exception &exc)
     {
       BOOST_LOG_TRIVIAL(error) << log_prefix << exc.what() << endl;
+      publish_listener.outstanding--;
+      overload_publish_errors++;
+      if (track)
+      {
+        std::lock_guard<std::mutex> lock(delivery_mutex);
+        in_flight.erase(pubmsg.get());
+      }
       return 1;
     }
     return 0;
   }
 
+  // get_delivery_json()
+  //   Return in-flight counts and ack latency histograms by message type.
+  nlohmann::ordered_json get_delivery_json()
+  {
+    std::lock_guard<std::mutex> lock(delivery_mutex);
+    nlohmann::ordered_json classes_json = nlohmann::ordered_json::object();
+
+    for (auto &stats : delivery_stats)
+    {
+      nlohmann::ordered_json buckets_json = nlohmann::ordered_json::object();
+      for (int i = 0; i < 12; i++)
+        buckets_json[std::to_string(delivery_buckets[i])] = stats.second.ack_buckets[i];
+      buckets_json["+Inf"] = stats.second.ack_buckets[12];
+
+      classes_json[stats.first] = {
+          {"count", stats.second.count},
+          {"ack_ms_avg", round_float(stats.second.ack_ms_sum / stats.second.count)},
+          {"ack_ms_max", stats.second.ack_ms_max},
+          {"event_to_ack_ms_avg", round_float(stats.second.event_ms_sum / stats.second.count)},
+          {"event_to_ack_ms_max", stats.second.event_ms_max},
+          {"ack_ms_buckets", buckets_json}};
+    }
+
+    nlohmann::ordered_json delivery_json = {
+        {"in_flight", in_flight.size()},
+        {"lost", delivery_lost},
+        {"types", classes_json}};
+    return delivery_json;
+  }
+
+  // system_ms()
+  //   Wall clock milliseconds since the epoch, for event_time/publish_time.
+  static int64_t system_ms()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
   // Paho mqtt::callbacks.
   // connection_lost()
   //   Paho MQTT: This method is called if the connection to the broker is lost.
@@ -1211,14 +4385,68 @@ public:
   {
     BOOST_LOG_TRIVIAL(error) << log_prefix << "Lost connection to broker: " << mqtt_broker << " " << cause;
     mqtt_connected = false;
+
+    // Let poll_one() pick the jittered retry time
+    reconnect_time_ms = -1;
+
+    // Messages that were not acknowledged are not resent with a clean session
+    std::lock_guard<std::mutex> lock(delivery_mutex);
+    delivery_lost += in_flight.size();
+    in_flight.clear();
+  }
+
+  // delivery_complete()
+  //   Paho MQTT: This method is called when the broker has acknowledged a QoS 1/2 message.
+  //   Record the latency from publish, and from the trunk-recorder event, to the ack.
+  void delivery_complete(mqtt::delivery_token_ptr tok)
+  {
+    if (!tok || !tok->get_message())
+      return;
+
+    int64_t now_ms = system_ms();
+    std::lock_guard<std::mutex> lock(delivery_mutex);
+    std::map<const mqtt::message *, In_Flight>::iterator it = in_flight.find(tok->get_message().get());
+    if (it == in_flight.end())
+      return;
+
+    double ack_ms = now_ms - it->second.publish_ms;
+    double event_ms = now_ms - it->second.event_ms;
+    Delivery_Stats &stats = delivery_stats[it->second.type];
+    int bucket = 0;
+    while ((bucket < 12) && (ack_ms > delivery_buckets[bucket]))
+      bucket++;
+
+    stats.count++;
+    stats.ack_buckets[bucket]++;
+    stats.ack_ms_sum += ack_ms;
+    stats.ack_ms_max = std::max(stats.ack_ms_max, ack_ms);
+    stats.event_ms_sum += event_ms;
+    stats.event_ms_max = std::max(stats.event_ms_max, event_ms);
+    ack_ms_average = (ack_ms_average * 0.9) + (ack_ms * 0.1);
+    in_flight.erase(it);
   }
 
   // connected()
   //   Paho MQTT: This method is called if the connection to the broker is activated.
+  //   Send the connected status, clear retained messages removed while disconnected (e.g. calls that ended), then
+  //   republish retained messages (config, systems, etc.)
   void connected(const string &cause)
   {
     BOOST_LOG_TRIVIAL(info) << log_prefix << "Connected to broker: " << mqtt_broker << " " << cause;
+    reconnect_backoff = reconnect_min;
+
+    std::lock_guard<std::mutex> lock(retained_mutex);
     mqtt_connected = true;
+    publish_message(mqtt_status_topic, mqtt_status_connected, true);
+    for (std::set<std::string>::iterator it = retained_cleared.begin(); it != retained_cleared.end(); ++it)
+    {
+      publish_message(*it, "", true);
+    }
+    retained_cleared.clear();
+    for (std::map<std::string, std::string>::iterator it = retained_cache.begin(); it != retained_cache.end(); ++it)
+    {
+      publish_message(it->first, it->second, true);
+    }
   }
 
   // ********************************
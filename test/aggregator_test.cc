@@ -0,0 +1,148 @@
+// MQTT Status aggregator test
+//   Builds the aggregator against the stand-in Paho client in test/stubs/paho, feeds it the messages of two
+//   instances recording the same P25 network, and checks what it publishes: systems matched by the WACN and
+//   system ID of system_state, duplicate events from another instance removed, repeated events from one instance
+//   kept, end messages matched by start time, and views not republished for a change of volatile fields alone.
+//   No broker is needed.
+//
+//   Usage: mqtt_status_aggregator_test
+
+#define main aggregator_main
+#include "../mqtt_status_aggregator.cc"
+#undef main
+
+std::vector<mqtt::message> mqtt::async_client::published;
+
+// Aggregator_Test
+//   Owns the aggregator, feeds it instance messages, and checks the messages it publishes.
+class Aggregator_Test
+{
+public:
+  Aggregator aggregator;
+  int failed = 0;
+
+  Aggregator_Test()
+  {
+    aggregator.status_topics = {"tr/east", "tr/west"};
+    aggregator.unit_topics = {"units/east", "units/west"};
+    aggregator.output_topic = "merged";
+    aggregator.start();
+    aggregator.connected("");
+  }
+
+  ~Aggregator_Test()
+  {
+    aggregator.stop();
+  }
+
+  // feed()
+  //   Deliver a message from an instance, as Paho would.
+  void feed(const std::string &topic, const std::string &payload)
+  {
+    aggregator.message_arrived(std::make_shared<mqtt::message>(topic, payload.data(), payload.size(), 1, false));
+  }
+
+  // take_published()
+  //   Return the messages published to topic since the last call, and forget all published messages.
+  std::vector<nlohmann::ordered_json> take_published(const std::string &topic)
+  {
+    std::vector<nlohmann::ordered_json> messages;
+    for (std::vector<mqtt::message>::iterator it = mqtt::async_client::published.begin(); it != mqtt::async_client::published.end(); ++it)
+    {
+      if (it->topic == topic)
+        messages.push_back(nlohmann::ordered_json::parse(it->payload));
+    }
+    mqtt::async_client::published.clear();
+    return messages;
+  }
+
+  void check(const std::string &name, bool passed)
+  {
+    if (!passed)
+    {
+      std::cout << name << " failed" << std::endl;
+      failed++;
+    }
+  }
+
+  // check_systems()
+  //   The systems lists are sent before the IDs are decoded; system_state gives both instances' systems one key,
+  //   so their calls on the same talkgroup are merged.
+  void check_systems()
+  {
+    feed("tr/east/systems", R"({"type":"systems","systems":[{"sys_num":0,"sys_name":"kc","sysid":"0","wacn":"0"}],"instance_id":"east"})");
+    feed("tr/west/systems", R"({"type":"systems","systems":[{"sys_num":2,"sys_name":"kingco","sysid":"0","wacn":"0"}],"instance_id":"west"})");
+    feed("tr/east/systems/kc", R"({"type":"system_state","system":{"sys_num":0,"sys_name":"kc","sysid":"3AB","wacn":"BEE00"},"instance_id":"east"})");
+    feed("tr/west/systems/kingco", R"({"type":"system_state","system":{"sys_num":2,"sys_name":"kingco","sysid":"3AB","wacn":"BEE00"},"instance_id":"west"})");
+    feed("tr/east/calls_active", R"({"type":"calls_active","calls":[{"id":"0_100_1000","sys_name":"kc","talkgroup":100,"elapsed":1,"call_state_type":"RECORDING"}],"instance_id":"east"})");
+    feed("tr/west/calls_active", R"({"type":"calls_active","calls":[{"id":"2_100_1001","sys_name":"kingco","talkgroup":100,"elapsed":1,"call_state_type":"MONITORING"}],"instance_id":"west"})");
+    aggregator.tick();
+
+    std::vector<nlohmann::ordered_json> views = take_published("merged/calls_active");
+    check("calls_active published", views.size() == 1);
+    if (views.size() != 1)
+      return;
+    const nlohmann::ordered_json &calls = views[0]["calls"];
+    check("calls merged across instances", calls.size() == 1);
+    if (calls.size() != 1)
+      return;
+    check("recorded call kept", calls[0].value("instance_id", "") == "east");
+    check("system keyed by WACN and system ID", calls[0].value("system", "") == "BEE00-3AB");
+    check("duplicate instance listed", calls[0]["duplicates"] == nlohmann::ordered_json::array({"west"}));
+  }
+
+  // check_volatile_fields()
+  //   A change of elapsed alone does not republish calls_active before refresh_seconds; a new call does.
+  void check_volatile_fields()
+  {
+    feed("tr/east/calls_active", R"({"type":"calls_active","calls":[{"id":"0_100_1000","sys_name":"kc","talkgroup":100,"elapsed":2,"call_state_type":"RECORDING"}],"instance_id":"east"})");
+    aggregator.tick();
+    check("volatile change not republished", take_published("merged/calls_active").empty());
+
+    feed("tr/east/calls_active", R"({"type":"calls_active","calls":[{"id":"0_100_1000","sys_name":"kc","talkgroup":100,"elapsed":3,"call_state_type":"RECORDING"},{"id":"0_200_1002","sys_name":"kc","talkgroup":200,"elapsed":1,"call_state_type":"RECORDING"}],"instance_id":"east"})");
+    aggregator.tick();
+    check("new call republished", take_published("merged/calls_active").size() == 1);
+  }
+
+  // check_unit_duplicates()
+  //   The same event from another instance is dropped; a repeated event from one instance is not.
+  void check_unit_duplicates()
+  {
+    feed("units/east/kc/on", R"({"type":"on","on":{"sys_name":"kc","unit":42},"timestamp":2000,"instance_id":"east"})");
+    feed("units/east/kc/on", R"({"type":"on","on":{"sys_name":"kc","unit":42},"timestamp":2001,"instance_id":"east"})");
+    check("same instance events kept", take_published("merged/unit/on").size() == 2);
+
+    feed("units/west/kingco/on", R"({"type":"on","on":{"sys_name":"kingco","unit":42},"timestamp":2001,"instance_id":"west"})");
+    check("other instance duplicate dropped", take_published("merged/unit/on").empty());
+
+    feed("units/west/kingco/on", R"({"type":"on","on":{"sys_name":"kingco","unit":43},"timestamp":2001,"instance_id":"west"})");
+    check("other unit kept", take_published("merged/unit/on").size() == 1);
+  }
+
+  // check_end_start_time()
+  //   End messages sent at the same time are matched by the transmission's start time: another instance's end of
+  //   the same transmission is dropped, and its end of a later transmission is kept.
+  void check_end_start_time()
+  {
+    feed("units/east/kc/end", R"({"type":"end","end":{"sys_name":"kc","unit":42,"talkgroup":100,"start_time":3000},"timestamp":3010,"instance_id":"east"})");
+    feed("units/west/kingco/end", R"({"type":"end","end":{"sys_name":"kingco","unit":42,"talkgroup":100,"start_time":3001},"timestamp":3010,"instance_id":"west"})");
+    check("duplicate end dropped", take_published("merged/unit/end").size() == 1);
+
+    feed("units/west/kingco/end", R"({"type":"end","end":{"sys_name":"kingco","unit":42,"talkgroup":100,"start_time":3008},"timestamp":3010,"instance_id":"west"})");
+    std::vector<nlohmann::ordered_json> ends = take_published("merged/unit/end");
+    check("later transmission kept", (ends.size() == 1) && (ends[0]["end"].value("instance_id", "") == "west"));
+  }
+};
+
+int main(int argc, char **argv)
+{
+  Aggregator_Test test;
+  test.check_systems();
+  test.check_volatile_fields();
+  test.check_unit_duplicates();
+  test.check_end_start_time();
+
+  if (test.failed == 0)
+    std::cout << "Aggregator checks passed" << std::endl;
+  return (test.failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,741 @@
+// MQTT Status payload test and benchmark
+//   Builds the plugin against the stand-in trunk-recorder classes in test/stubs, drives the message builders and
+//   plugin hooks with fixed calls, recorders, systems, and units, and compares every payload byte-for-byte with the
+//   golden corpus in test/golden.  Messages sent through the hooks are read back from the plugin's shared memory
+//   ring, so the whole send path is covered without a broker.  The call, recorder, and system payloads are also
+//   checked against the get_stats() builders they replaced, which are kept here as the baseline; the stub
+//   get_stats() builds the same property tree as trunk-recorder.
+//
+//   Fields that depend on the clock ("timestamp", "elapsed", "event_time", "publish_time") are removed before
+//   comparing.
+//
+//   Usage: mqtt_status_payload_test <golden dir> [--update] [--bench]
+//     --update   rewrite the golden corpus from the current output
+//     --bench    also report serialized size and ns/message per message type and encoding (JSON, zlib), the time
+//                of a calls_active and recorders snapshot at 50 calls and 100 recorders, built from the getters
+//                and from get_stats(), and unit and trunk message throughput for 1, 4, and 16 systems by
+//                serialize_threads
+
+#include "../mqtt_status_plugin.cc"
+
+#include <unistd.h>
+
+int frequency_format = 0;
+
+std::string log_header(std::string short_name, long call_num, std::string talkgroup_display, double freq)
+{
+  return "[" + short_name + "]\t" + std::to_string(call_num) + "C\tTG: " + talkgroup_display + "\tFreq: " + std::to_string(freq) + "\t";
+}
+
+// Mqtt_Status_Test
+//   Friend of Mqtt_Status; owns the plugin and the fixtures, and collects the messages it sends.
+class Mqtt_Status_Test
+{
+public:
+  struct Result
+  {
+    std::string name;
+    std::string topic;
+    std::string payload;
+  };
+
+  boost::shared_ptr<Mqtt_Status> plugin;
+  Config config;
+  std::vector<Source *> sources;
+  std::vector<System *> systems;
+  std::vector<Recorder *> recorders;
+  std::vector<Call *> calls;
+  std::string shm_name;
+  mqtt_status_ipc::Ring_Reader reader;
+
+  ~Mqtt_Status_Test()
+  {
+    for (Source *source : sources)
+      delete source;
+    for (System *sys : systems)
+      delete sys;
+    for (Recorder *recorder : recorders)
+      delete recorder;
+    for (Call *call : calls)
+      delete call;
+  }
+
+  // setup()
+  //   Create the fixtures and start the plugin with a shared memory ring.  extra_config is merged into the
+  //   plugin config (e.g. serialize_threads for the benchmark).
+  void setup(int system_count, int recorder_count, int call_count, json extra_config = json::object())
+  {
+    shm_name = "/mqtt_status_test_" + std::to_string(getpid());
+
+    config.capture_dir = "/tmp";
+    config.upload_server = "";
+    config.call_timeout = 3;
+    config.log_file = false;
+    config.instance_id = "test";
+    config.instance_key = "";
+    config.broadcast_signals = false;
+    config.frequency_format = 0;
+
+    Source *source = new Source();
+    source->num = 0;
+    source->center = 852000000;
+    source->min_hz = 851000000;
+    source->max_hz = 853000000;
+    source->error = -300;
+    source->gain = 42;
+    source->digital_recorders = recorder_count;
+    source->gain_stages = {{"LNA", 32}, {"MIX", 10}};
+    sources.push_back(source);
+
+    for (int i = 0; i < system_count; i++)
+    {
+      System *sys = new System();
+      sys->sys_num = i;
+      sys->short_name = "sys" + std::to_string(i);
+      sys->talkgroups_file = sys->short_name + ".csv";
+      sys->control_channels = {851012500.0 + i * 12500};
+      sys->current_control_channel = sys->control_channels[0];
+      sys->decoderate = 39.5;
+      sys->sys_rfss = 1;
+      sys->sys_site_id = i + 1;
+      sys->sys_id = 0x3ab;
+      sys->wacn = 0xbee00;
+      sys->nac = 0x3a6;
+      sys->unit_tags = {{1001, "Engine 1"}, {1002, "Medic 2"}};
+      sys->talkgroups[100] = {"Fire Disp", "Fire Dispatch", "Fire", "Fire Dispatch"};
+      sys->talkgroups[200] = {"Law Disp", "Law Dispatch", "Police", "Law Dispatch"};
+      sys->talkgroup_patches[100] = {100, 101};
+      systems.push_back(sys);
+    }
+
+    for (int i = 0; i < recorder_count; i++)
+    {
+      Recorder *recorder = new Recorder();
+      recorder->num = i;
+      recorder->source = source;
+      recorder->state = (i % 3 == 0) ? RECORDING : IDLE;
+      recorder->freq = 851500000 + i * 12500;
+      recorder->count = 10 + i;
+      recorder->duration = 123.25 + i;
+      recorders.push_back(recorder);
+    }
+    source->recorders = recorders;
+
+    for (int i = 0; i < call_count; i++)
+    {
+      Call *call = new Call();
+      call->system = systems[i % system_count];
+      call->sys_num = call->system->sys_num;
+      call->short_name = call->system->short_name;
+      call->call_num = 5000 + i;
+      call->freq = 851500000 + i * 12500;
+      call->source_id = 1001 + (i % 2);
+      call->talkgroup = (i % 2 == 0) ? 100 : 200;
+      call->talkgroup_display = std::to_string(call->talkgroup);
+      call->current_length = 4.5;
+      call->state = (i % 4 == 3) ? MONITORING : RECORDING;
+      call->monitoring_state = (i % 4 == 3) ? DUPLICATE : UNSPECIFIED;
+      call->phase2_tdma = (i % 2 == 1);
+      call->tdma_slot = i % 2;
+      call->emergency = (i == 1);
+      call->start_time = 1700000000 + i;
+      call->stop_time = 1700000000 + i;
+      call->recorder = (recorders.empty() || (call->state != RECORDING)) ? nullptr : recorders[i % recorders.size()];
+      calls.push_back(call);
+    }
+
+    json plugin_config = {
+        {"broker", "tcp://127.0.0.1:1"},
+        {"client_id", "tr-status-test"},
+        {"topic", "tr"},
+        {"unit_topic", "tr/units"},
+        {"message_topic", "tr/messages"},
+        {"entity_topics", true},
+        {"activity_interval", 60},
+        {"ipc_shm_name", shm_name},
+        {"ipc_shm_size", 16777216},
+        {"shutdown_timeout", 0}};
+    plugin_config.update(extra_config);
+
+    plugin = Mqtt_Status::create();
+    plugin->parse_config(plugin_config);
+    plugin->init(&config, sources, systems);
+    plugin->start();
+    reader.open(shm_name);
+  }
+
+  void teardown()
+  {
+    plugin->stop();
+    reader.close();
+  }
+
+  Call_Data_t get_call_data(Call *call)
+  {
+    Call_Data_t call_info = {};
+    call_info.talkgroup = call->talkgroup;
+    call_info.talkgroup_tag = "Fire Dispatch";
+    call_info.talkgroup_alpha_tag = "Fire Disp";
+    call_info.talkgroup_description = "Fire Dispatch";
+    call_info.talkgroup_group = "Fire";
+    call_info.talkgroup_display = call->talkgroup_display;
+    call_info.call_num = call->call_num;
+    call_info.freq = call->freq;
+    call_info.start_time = 1700000000;
+    call_info.stop_time = 1700000012;
+    call_info.short_name = call->short_name;
+    call_info.audio_type = "digital";
+    call_info.error_count = 3;
+    call_info.spike_count = 1;
+    call_info.freq_error = -120;
+    call_info.signal = -45;
+    call_info.noise = -110;
+    call_info.source_num = 0;
+    call_info.recorder_num = 2;
+    call_info.length = 11.5;
+    call_info.sys_num = call->sys_num;
+    call_info.process_call_time = 1700000013;
+    call_info.transmission_source_list = {{1001, 1700000000, 0, false, "", ""}, {1002, 1700000006, 5.5, false, "", ""}, {0, 1700000012, 11.5, false, "", ""}};
+    call_info.transmission_list = {{1001, 1700000000, 1700000005, 44000, 1, 2, call->freq, 5.5, "a.wav"},
+                                   {1002, 1700000006, 1700000012, 48000, 0, 1, call->freq, 6.0, "b.wav"},
+                                   {0, 1700000012, 1700000013, 8000, 0, 0, call->freq, 1.0, "c.wav"}};
+    strcpy(call_info.filename, "/tmp/call.wav");
+    strcpy(call_info.converted, "/tmp/call.m4a");
+    return call_info;
+  }
+
+  std::vector<TrunkMessage> get_trunk_messages(System *sys)
+  {
+    TrunkMessage grant = {};
+    grant.message_type = GRANT;
+    grant.meta = "";
+    grant.freq = 851500000;
+    grant.talkgroup = 100;
+    grant.source = 1001;
+    grant.sys_num = sys->sys_num;
+    grant.sys_id = sys->sys_id;
+    grant.nac = sys->nac;
+    grant.wacn = sys->wacn;
+    grant.opcode = 0x00;
+
+    TrunkMessage affiliation = grant;
+    affiliation.message_type = AFFILIATION;
+    affiliation.opcode = 0x28;
+
+    TrunkMessage unknown = grant;
+    unknown.message_type = UNKNOWN;
+    unknown.opcode = 0x50;
+    return {grant, affiliation, unknown};
+  }
+
+  // check_baseline()
+  //   Compare each fixture's payload from the getters with the get_stats() baseline; return the number that differ.
+  int check_baseline()
+  {
+    Mqtt_Status &p = *plugin;
+    int failed = 0;
+    for (Call *call : calls)
+      failed += compare("get_call_json", p.get_call_json(call), stats_call_json(call));
+    for (Recorder *recorder : recorders)
+      failed += compare("get_recorder_json", p.get_recorder_json(recorder), stats_recorder_json(recorder));
+    for (System *sys : systems)
+      failed += compare("get_system_json", p.get_system_json(sys), stats_system_json(sys));
+    return failed;
+  }
+
+  // check_topic_templates()
+  //   Check that empty templates are rejected and placeholders without a value render as "none"; return the
+  //   number of failures.
+  int check_topic_templates()
+  {
+    Mqtt_Status &p = *plugin;
+    int failed = 0;
+    p.compile_topic_templates({{"call_start", ""}, {"call_end", 5}, {"unit", "{unit_topic}/{sys_name}/{type}/{talkgroup}/{unit}"}});
+    if (p.topic_templates.count("call_start") || p.topic_templates.count("call_end"))
+    {
+      std::cout << "empty or non-string topic template was not rejected" << std::endl;
+      failed++;
+    }
+
+    std::string topic;
+    p.render_topic(p.topic_templates["on"], "on", {systems[0], 0, 1001}, topic);
+    failed += compare_topic(topic, "tr/units/" + systems[0]->get_short_name() + "/on/none/1001");
+    p.render_topic(p.topic_templates["join"], "join", {NULL, 100, 0}, topic);
+    failed += compare_topic(topic, "tr/units/none/join/100/none");
+
+    p.compile_topic_templates(json::object());
+    return failed;
+  }
+
+  static int compare_topic(const std::string &actual, const std::string &expected)
+  {
+    if (actual == expected)
+      return 0;
+    std::cout << "render_topic differs\n  expected: " << expected << "\n  actual:   " << actual << std::endl;
+    return 1;
+  }
+
+  static int compare(const std::string &name, nlohmann::ordered_json actual, nlohmann::ordered_json expected)
+  {
+    actual.erase("elapsed");
+    expected.erase("elapsed");
+    if (actual == expected)
+      return 0;
+    std::cout << name << " differs\n  expected: " << expected.dump() << "\n  actual:   " << actual.dump() << std::endl;
+    return 1;
+  }
+
+  // read_messages()
+  //   Read what the plugin has written to the ring since the last call.
+  std::vector<Result> read_messages(const std::string &name)
+  {
+    std::vector<Result> results;
+    std::string topic;
+    std::string payload;
+    uint64_t sequence;
+    while (reader.read(topic, payload, sequence) == mqtt_status_ipc::Ring_Reader::MESSAGE)
+      results.push_back({name, topic, payload});
+    return results;
+  }
+
+  // run_cases()
+  //   The golden corpus: builder output first, then each hook's messages as read from the ring.
+  std::vector<Result> run_cases()
+  {
+    std::vector<Result> results;
+    Mqtt_Status &p = *plugin;
+    read_messages("");
+
+    for (Call *call : calls)
+      results.push_back({"get_call_json", "", p.get_call_json(call).dump()});
+    for (Recorder *recorder : recorders)
+      results.push_back({"get_recorder_json", "", p.get_recorder_json(recorder).dump()});
+    for (System *sys : systems)
+      results.push_back({"get_system_json", "", p.get_system_json(sys).dump()});
+    results.push_back({"get_unit_json", "", p.get_unit_json(systems[0], 1001).dump()});
+    results.push_back({"get_unit_tg_json", "", p.get_unit_tg_json(systems[0], 1002, 200).dump()});
+    results.push_back({"get_unit_tg_json", "", p.get_unit_tg_json(systems[0], 9999, 100).dump()});
+
+    append(results, run_hook("send_config", [&]
+                             { p.send_config(sources, systems); }));
+    append(results, run_hook("setup_recorder", [&]
+                             { p.setup_recorder(recorders[0]); }));
+    append(results, run_hook("call_start", [&]
+                             { p.call_start(calls[0]); }));
+    append(results, run_hook("calls_active", [&]
+                             { p.calls_active(calls); }));
+    append(results, run_hook("trunk_message", [&]
+                             { p.trunk_message(get_trunk_messages(systems[0]), systems[0]); }));
+    append(results, run_hook("unit_events", [&]
+                             {
+                               p.unit_registration(systems[0], 1001);
+                               p.unit_deregistration(systems[0], 1002);
+                               p.unit_acknowledge_response(systems[0], 1001);
+                               p.unit_group_affiliation(systems[0], 1001, 100);
+                               p.unit_data_grant(systems[0], 1002);
+                               p.unit_answer_request(systems[0], 1001, 200);
+                               p.unit_location(systems[0], 1002, 100); }));
+    append(results, run_hook("call_end", [&]
+                             { p.call_end(get_call_data(calls[0])); }));
+    append(results, run_hook("send_activity", [&]
+                             { p.send_activity(60); }));
+    return results;
+  }
+
+  template <typename Hook>
+  std::vector<Result> run_hook(const std::string &name, Hook hook)
+  {
+    hook();
+    return read_messages(name);
+  }
+
+  static void append(std::vector<Result> &results, const std::vector<Result> &more)
+  {
+    results.insert(results.end(), more.begin(), more.end());
+  }
+
+  // normalize()
+  //   Remove the fields that depend on the clock, at any depth.
+  static void normalize(nlohmann::ordered_json &value)
+  {
+    if (value.is_object())
+    {
+      const std::vector<std::string> volatile_fields = {"timestamp", "elapsed", "event_time", "publish_time"};
+      for (const std::string &field : volatile_fields)
+        value.erase(field);
+      for (auto &item : value.items())
+        normalize(item.value());
+    }
+    else if (value.is_array())
+    {
+      for (auto &item : value)
+        normalize(item);
+    }
+  }
+
+  static std::string to_line(const Result &result)
+  {
+    nlohmann::ordered_json payload = nlohmann::ordered_json::parse(result.payload, nullptr, false);
+    if (payload.is_discarded())
+      payload = result.payload;
+    normalize(payload);
+    nlohmann::ordered_json line = {{"case", result.name}, {"topic", result.topic}, {"payload", payload}};
+    return line.dump();
+  }
+
+  // bench_case()
+  //   Time a builder and its encodings; one line per message type.
+  template <typename Build>
+  static void bench_case(const std::string &name, int iterations, Build build)
+  {
+    std::string plain;
+    std::string compressed;
+    int64_t build_ns = time_ns([&]
+                               {
+                                 for (int i = 0; i < iterations; i++)
+                                   plain = build().dump(); });
+    int64_t dump_only_ns = 0;
+    {
+      nlohmann::ordered_json data = build();
+      dump_only_ns = time_ns([&]
+                             {
+                               for (int i = 0; i < iterations; i++)
+                                 plain = data.dump(); });
+    }
+    int64_t zlib_ns = time_ns([&]
+                              {
+                                for (int i = 0; i < iterations; i++)
+                                  Mqtt_Status::zlib_compress(plain, compressed, Z_DEFAULT_COMPRESSION, false); });
+
+    printf("%-22s %10.0f %10.0f %10.0f %9zu %9zu\n", name.c_str(), (double)build_ns / iterations, (double)dump_only_ns / iterations,
+           (double)zlib_ns / iterations, plain.size(), compressed.size());
+  }
+
+  template <typename Work>
+  static int64_t time_ns(Work work)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    work();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // run_bench()
+  //   ns/message to build and dump (JSON) each message type, to dump alone, and to zlib compress the dump.
+  void run_bench()
+  {
+    Mqtt_Status &p = *plugin;
+    int n = 20000;
+    printf("%-22s %10s %10s %10s %9s %9s\n", "message", "build+dump", "dump", "zlib", "json B", "zlib B");
+    bench_case("call", n, [&]
+               { return p.get_call_json(calls[0]); });
+    bench_case("recorder", n, [&]
+               { return p.get_recorder_json(recorders[0]); });
+    bench_case("system", n, [&]
+               { return p.get_system_json(systems[0]); });
+    bench_case("unit", n, [&]
+               { return p.get_unit_json(systems[0], 1001); });
+    bench_case("unit_tg", n, [&]
+               { return p.get_unit_tg_json(systems[0], 1001, 100); });
+    bench_case("config", n / 10, [&]
+               {
+                 nlohmann::ordered_json config_json;
+                 for (Source *source : sources)
+                   config_json["sources"] += p.get_source_config_json(source);
+                 for (System *sys : systems)
+                   config_json["systems"] += p.get_system_config_json(sys);
+                 return config_json; });
+  }
+
+  // run_snapshot_bench()
+  //   Time one calls_active snapshot and one recorders snapshot at the fixture's size, built and dumped from the
+  //   getters and from the get_stats() baseline.
+  void run_snapshot_bench()
+  {
+    Mqtt_Status &p = *plugin;
+    uint64_t calls_mask = p.get_field_mask("calls_active");
+    uint64_t recorders_mask = p.get_field_mask("recorders");
+    int n = 500;
+    int64_t calls_ns = time_ns([&]
+                               {
+                                 for (int i = 0; i < n; i++)
+                                   p.get_calls_json(calls).dump(); });
+    int64_t calls_stats_ns = time_ns([&]
+                                     {
+                                       for (int i = 0; i < n; i++)
+                                       {
+                                         nlohmann::ordered_json calls_json;
+                                         for (Call *call : calls)
+                                           calls_json += stats_call_json(call, calls_mask);
+                                         calls_json.dump();
+                                       } });
+    int64_t recorders_ns = time_ns([&]
+                                   {
+                                     for (int i = 0; i < n; i++)
+                                     {
+                                       nlohmann::ordered_json recorders_json = nlohmann::ordered_json::array();
+                                       for (Recorder *recorder : recorders)
+                                         recorders_json += p.get_recorder_json(recorder, recorders_mask);
+                                       recorders_json.dump();
+                                     } });
+    int64_t recorders_stats_ns = time_ns([&]
+                                         {
+                                           for (int i = 0; i < n; i++)
+                                           {
+                                             nlohmann::ordered_json recorders_json = nlohmann::ordered_json::array();
+                                             for (Recorder *recorder : recorders)
+                                               recorders_json += stats_recorder_json(recorder, recorders_mask);
+                                             recorders_json.dump();
+                                           } });
+
+    printf("%-22s %10s %10s\n", "snapshot", "getters", "get_stats");
+    printf("%-22s %10.0f %10.0f\n", (std::to_string(calls.size()) + " calls").c_str(), (double)calls_ns / n, (double)calls_stats_ns / n);
+    printf("%-22s %10.0f %10.0f\n", (std::to_string(recorders.size()) + " recorders").c_str(), (double)recorders_ns / n, (double)recorders_stats_ns / n);
+  }
+
+  // run_shard_bench()
+  //   Unit and trunk messages per second through the hooks until the send shards are drained, and the time spent
+  //   in the hooks, at the fixture's system count.  The hooks wait while the shards are nearly full, rather than
+  //   drop messages.
+  void run_shard_bench(int serialize_threads)
+  {
+    Mqtt_Status &p = *plugin;
+    int n = 20000;
+    int64_t hook_ns = 0;
+    int64_t ns = time_ns([&]
+                         {
+                           hook_ns = time_ns([&]
+                                             {
+                                               for (int i = 0; i < n; i++)
+                                               {
+                                                 System *sys = systems[i % systems.size()];
+                                                 p.unit_group_affiliation(sys, 1001 + (i % 64), (i % 2 == 0) ? 100 : 200);
+                                                 p.trunk_message(get_trunk_messages(sys), sys);
+                                                 while ((serialize_threads > 0) && (i % 256 == 0) && (p.get_send_shard_queued() > p.send_shard_max / 2))
+                                                   std::this_thread::yield();
+                                               } });
+                           p.stop_send_shards(); });
+    int messages = n * 4;
+    printf("%-8zu %-8d %12.0f %12.0f %10lu\n", systems.size(), serialize_threads, (double)messages * 1e9 / ns, (double)hook_ns / messages,
+           (unsigned long)p.send_shard_dropped);
+  }
+
+  // stats_call_json()
+  //   get_call_json() as it was before it read the call's getters.
+  nlohmann::ordered_json stats_call_json(Call *call, uint64_t mask = Mqtt_Status::all_fields)
+  {
+    Mqtt_Status &p = *plugin;
+    boost::property_tree::ptree stat_node = call->get_stats();
+    nlohmann::ordered_json call_json = nlohmann::ordered_json::object();
+
+    if (p.has_field(mask, Mqtt_Status::CALL_ID))
+      call_json["id"] = stat_node.get<std::string>("id");
+    if (p.has_field(mask, Mqtt_Status::CALL_CALL_NUM))
+      call_json["call_num"] = stat_node.get<long>("callNum");
+    if (p.has_field(mask, Mqtt_Status::CALL_SYS_NUM))
+      call_json["sys_num"] = stat_node.get<int>("sysNum");
+    if (p.has_field(mask, Mqtt_Status::CALL_SYS_NAME))
+      call_json["sys_name"] = stat_node.get<std::string>("shortName");
+    if (p.has_field(mask, Mqtt_Status::CALL_FREQ))
+      call_json["freq"] = stat_node.get<double>("freq");
+    if (p.has_field(mask, Mqtt_Status::CALL_UNIT))
+      call_json["unit"] = stat_node.get<long>("srcId");
+    if (p.has_field(mask, Mqtt_Status::CALL_UNIT_ALPHA_TAG))
+      call_json["unit_alpha_tag"] = call->get_system()->find_unit_tag(stat_node.get<long>("srcId"));
+    p.add_talkgroup_json(call_json, call->get_system(), stat_node.get<int>("talkgroup"), mask >> Mqtt_Status::CALL_TALKGROUP);
+    if (p.has_field(mask, Mqtt_Status::CALL_ELAPSED))
+      call_json["elapsed"] = stat_node.get<long>("elapsed");
+    if (p.has_field(mask, Mqtt_Status::CALL_LENGTH))
+      call_json["length"] = p.round_float(stat_node.get<double>("length"));
+    if (p.has_field(mask, Mqtt_Status::CALL_CALL_STATE))
+      call_json["call_state"] = stat_node.get<int>("state");
+    if (p.has_field(mask, Mqtt_Status::CALL_CALL_STATE_TYPE))
+      call_json["call_state_type"] = p.tr_state[stat_node.get<int>("state")];
+    if (p.has_field(mask, Mqtt_Status::CALL_MON_STATE))
+      call_json["mon_state"] = stat_node.get<int>("monState");
+    if (p.has_field(mask, Mqtt_Status::CALL_MON_STATE_TYPE))
+      call_json["mon_state_type"] = p.mon_state[stat_node.get<int>("monState")];
+    if (p.has_field(mask, Mqtt_Status::CALL_AUDIO_TYPE))
+    {
+      if (call->get_is_analog())
+        call_json["audio_type"] = "analog";
+      else if (call->get_phase2_tdma())
+        call_json["audio_type"] = "digital tdma";
+      else
+        call_json["audio_type"] = "digital";
+    }
+    if (p.has_field(mask, Mqtt_Status::CALL_PHASE2_TDMA))
+      call_json["phase2_tdma"] = stat_node.get<bool>("phase2");
+    if (p.has_field(mask, Mqtt_Status::CALL_TDMA_SLOT))
+      call_json["tdma_slot"] = call->get_tdma_slot();
+    if (p.has_field(mask, Mqtt_Status::CALL_ANALOG))
+      call_json["analog"] = stat_node.get<bool>("analog", false);
+    if (p.has_field(mask, Mqtt_Status::CALL_REC_NUM))
+      call_json["rec_num"] = stat_node.get<int>("recNum", -1);
+    if (p.has_field(mask, Mqtt_Status::CALL_SRC_NUM))
+      call_json["src_num"] = stat_node.get<int>("srcNum", -1);
+    if (p.has_field(mask, Mqtt_Status::CALL_REC_STATE))
+      call_json["rec_state"] = stat_node.get<int>("recState", -1);
+    if (p.has_field(mask, Mqtt_Status::CALL_REC_STATE_TYPE))
+      call_json["rec_state_type"] = p.tr_state[stat_node.get<int>("recState", -1)];
+    if (p.has_field(mask, Mqtt_Status::CALL_CONVENTIONAL))
+      call_json["conventional"] = stat_node.get<bool>("conventional");
+    if (p.has_field(mask, Mqtt_Status::CALL_ENCRYPTED))
+      call_json["encrypted"] = stat_node.get<bool>("encrypted");
+    if (p.has_field(mask, Mqtt_Status::CALL_EMERGENCY))
+      call_json["emergency"] = stat_node.get<bool>("emergency");
+    if (p.has_field(mask, Mqtt_Status::CALL_START_TIME))
+      call_json["start_time"] = stat_node.get<long>("startTime");
+    if (p.has_field(mask, Mqtt_Status::CALL_STOP_TIME))
+      call_json["stop_time"] = stat_node.get<long>("stopTime");
+    return call_json;
+  }
+
+  // stats_recorder_json()
+  //   get_recorder_json() as it was before it read the recorder's getters.
+  nlohmann::ordered_json stats_recorder_json(Recorder *recorder, uint64_t mask = Mqtt_Status::all_fields)
+  {
+    Mqtt_Status &p = *plugin;
+    boost::property_tree::ptree stat_node = recorder->get_stats();
+    nlohmann::ordered_json recorder_json = nlohmann::ordered_json::object();
+
+    if (p.has_field(mask, Mqtt_Status::REC_ID))
+      recorder_json["id"] = stat_node.get<std::string>("id");
+    if (p.has_field(mask, Mqtt_Status::REC_SRC_NUM))
+      recorder_json["src_num"] = stat_node.get<int>("srcNum");
+    if (p.has_field(mask, Mqtt_Status::REC_REC_NUM))
+      recorder_json["rec_num"] = stat_node.get<int>("recNum");
+    if (p.has_field(mask, Mqtt_Status::REC_TYPE))
+      recorder_json["type"] = stat_node.get<std::string>("type");
+    if (p.has_field(mask, Mqtt_Status::REC_DURATION))
+      recorder_json["duration"] = p.round_float(stat_node.get<double>("duration"));
+    if (p.has_field(mask, Mqtt_Status::REC_FREQ))
+      recorder_json["freq"] = recorder->get_freq();
+    if (p.has_field(mask, Mqtt_Status::REC_COUNT))
+      recorder_json["count"] = stat_node.get<int>("count");
+    if (p.has_field(mask, Mqtt_Status::REC_REC_STATE))
+      recorder_json["rec_state"] = stat_node.get<int>("state");
+    if (p.has_field(mask, Mqtt_Status::REC_REC_STATE_TYPE))
+      recorder_json["rec_state_type"] = p.tr_state[stat_node.get<int>("state")];
+    if (p.has_field(mask, Mqtt_Status::REC_SQUELCHED))
+      recorder_json["squelched"] = recorder->is_squelched();
+    return recorder_json;
+  }
+
+  // stats_system_json()
+  //   get_system_json() as it was before it read the system's getters.
+  nlohmann::ordered_json stats_system_json(System *sys, uint64_t mask = Mqtt_Status::all_fields)
+  {
+    Mqtt_Status &p = *plugin;
+    boost::property_tree::ptree stat_node = sys->get_stats();
+    nlohmann::ordered_json system_json = nlohmann::ordered_json::object();
+
+    if (p.has_field(mask, Mqtt_Status::SYS_SYS_NUM))
+      system_json["sys_num"] = stat_node.get<int>("id");
+    if (p.has_field(mask, Mqtt_Status::SYS_SYS_NAME))
+      system_json["sys_name"] = stat_node.get<std::string>("name");
+    if (p.has_field(mask, Mqtt_Status::SYS_TYPE))
+      system_json["type"] = stat_node.get<std::string>("type");
+    if (p.has_field(mask, Mqtt_Status::SYS_SYSID))
+      system_json["sysid"] = p.int_to_hex(stat_node.get<int>("sysid"), 0);
+    if (p.has_field(mask, Mqtt_Status::SYS_WACN))
+      system_json["wacn"] = p.int_to_hex(stat_node.get<int>("wacn"), 0);
+    if (p.has_field(mask, Mqtt_Status::SYS_NAC))
+      system_json["nac"] = p.int_to_hex(stat_node.get<int>("nac"), 0);
+    if (p.has_field(mask, Mqtt_Status::SYS_RFSS))
+      system_json["rfss"] = sys->get_sys_rfss();
+    if (p.has_field(mask, Mqtt_Status::SYS_SITE_ID))
+      system_json["site_id"] = sys->get_sys_site_id();
+    return system_json;
+  }
+};
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: mqtt_status_payload_test <golden dir> [--update] [--bench]" << std::endl;
+    return 2;
+  }
+  std::string golden_file = std::string(argv[1]) + "/payloads.ndjson";
+  bool update = false;
+  bool bench = false;
+  for (int i = 2; i < argc; i++)
+  {
+    update |= (std::string(argv[i]) == "--update");
+    bench |= (std::string(argv[i]) == "--bench");
+  }
+
+  logging::core::get()->set_filter(logging::trivial::severity >= logging::trivial::warning);
+
+  Mqtt_Status_Test test;
+  test.setup(2, 4, 4);
+  int ret = ((test.check_baseline() == 0) && (test.check_topic_templates() == 0)) ? 0 : 1;
+  std::vector<Mqtt_Status_Test::Result> results = test.run_cases();
+
+  std::string output;
+  for (const Mqtt_Status_Test::Result &result : results)
+    output += Mqtt_Status_Test::to_line(result) + "\n";
+
+  if (update)
+  {
+    std::ofstream file(golden_file);
+    file << output;
+    std::cout << "Wrote " << results.size() << " payloads to " << golden_file << std::endl;
+  }
+  else
+  {
+    std::ifstream file(golden_file);
+    std::stringstream golden;
+    golden << file.rdbuf();
+
+    // Report the first line that differs
+    std::istringstream expected_lines(golden.str());
+    std::istringstream actual_lines(output);
+    std::string expected;
+    std::string actual;
+    int line = 0;
+    while (true)
+    {
+      bool more_expected = (bool)std::getline(expected_lines, expected);
+      bool more_actual = (bool)std::getline(actual_lines, actual);
+      line++;
+      if (!more_expected && !more_actual)
+        break;
+      if ((more_expected != more_actual) || (expected != actual))
+      {
+        std::cout << golden_file << ":" << line << " differs\n  expected: " << (more_expected ? expected : "[end]") << "\n  actual:   " << (more_actual ? actual : "[end]") << std::endl;
+        ret = 1;
+        break;
+      }
+    }
+    if (ret == 0)
+      std::cout << results.size() << " payloads match " << golden_file << std::endl;
+  }
+
+  if (bench)
+    test.run_bench();
+  test.teardown();
+
+  // calls_active and recorders snapshots at 50 calls and 100 recorders
+  if (bench)
+  {
+    Mqtt_Status_Test snapshot;
+    snapshot.setup(4, 100, 50, {{"ipc_shm_name", ""}});
+    snapshot.run_snapshot_bench();
+    snapshot.teardown();
+
+    // Systems x serialize_threads sweep
+    printf("%-8s %-8s %12s %12s %10s\n", "systems", "threads", "messages/s", "hook ns/msg", "dropped");
+    for (int system_count : {1, 4, 16})
+    {
+      for (int threads : {0, 1, 2, 4, 8})
+      {
+        Mqtt_Status_Test shards;
+        shards.setup(system_count, 1, 0, {{"serialize_threads", threads}});
+        shards.run_shard_bench(threads);
+        shards.teardown();
+      }
+    }
+  }
+  return ret;
+}
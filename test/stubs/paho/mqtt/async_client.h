@@ -0,0 +1,136 @@
+// Stand-in for the Paho MQTT C++ client, for the aggregator test.
+//   Only the members the aggregator uses are declared.  Nothing is sent; published messages are kept in
+//   mqtt::async_client::published so a test can check what the aggregator would have sent.
+
+#ifndef MQTT_STATUS_TEST_ASYNC_CLIENT_H
+#define MQTT_STATUS_TEST_ASYNC_CLIENT_H
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mqtt
+{
+class exception : public std::runtime_error
+{
+public:
+  exception() : std::runtime_error("mqtt") {}
+};
+
+class message
+{
+public:
+  std::string topic;
+  std::string payload;
+  bool retained = false;
+
+  message() {}
+  message(const std::string &topic, const void *payload, size_t len, int qos, bool retained)
+      : topic(topic), payload((const char *)payload, len), retained(retained) {}
+
+  const std::string &get_topic() const { return topic; }
+  std::string get_payload_str() const { return payload; }
+  bool is_retained() const { return retained; }
+};
+typedef std::shared_ptr<message> message_ptr;
+typedef std::shared_ptr<const message> const_message_ptr;
+
+class message_ptr_builder
+{
+public:
+  message_ptr_builder &topic(const std::string &topic)
+  {
+    msg->topic = topic;
+    return *this;
+  }
+  message_ptr_builder &payload(const std::string &payload)
+  {
+    msg->payload = payload;
+    return *this;
+  }
+  message_ptr_builder &qos(int qos) { return *this; }
+  message_ptr_builder &retained(bool retained)
+  {
+    msg->retained = retained;
+    return *this;
+  }
+  message_ptr finalize() { return msg; }
+
+private:
+  message_ptr msg = std::make_shared<message>();
+};
+
+class token
+{
+public:
+  virtual ~token() {}
+  void wait() {}
+  template <class Rep, class Period>
+  bool wait_for(const std::chrono::duration<Rep, Period> &timeout) { return true; }
+};
+typedef std::shared_ptr<token> token_ptr;
+
+class delivery_token : public token
+{
+};
+typedef std::shared_ptr<delivery_token> delivery_token_ptr;
+
+class connect_options
+{
+public:
+  void set_user_name(const std::string &user_name) {}
+  void set_password(const std::string &password) {}
+};
+
+class connect_options_builder
+{
+public:
+  connect_options_builder &clean_session(bool clean = true) { return *this; }
+  template <class Min, class Max>
+  connect_options_builder &automatic_reconnect(Min min_retry, Max max_retry) { return *this; }
+  connect_options_builder &will(const message &will) { return *this; }
+  connect_options finalize() { return connect_options(); }
+};
+
+class callback
+{
+public:
+  virtual ~callback() {}
+  virtual void connected(const std::string &cause) {}
+  virtual void connection_lost(const std::string &cause) {}
+  virtual void message_arrived(const_message_ptr msg) {}
+};
+
+class string_collection
+{
+public:
+  static std::shared_ptr<string_collection> create(const std::vector<std::string> &strings) { return std::make_shared<string_collection>(); }
+};
+
+class iasync_client
+{
+public:
+  typedef std::vector<int> qos_collection;
+};
+
+class async_client
+{
+public:
+  static std::vector<message> published;
+
+  async_client(const std::string &server_uri, const std::string &client_id) {}
+  void set_callback(callback &cb) {}
+  token_ptr connect(connect_options options) { return std::make_shared<token>(); }
+  token_ptr disconnect() { return std::make_shared<token>(); }
+  token_ptr subscribe(std::shared_ptr<string_collection> topics, const iasync_client::qos_collection &qos) { return std::make_shared<token>(); }
+  delivery_token_ptr publish(message_ptr msg)
+  {
+    published.push_back(*msg);
+    return std::make_shared<delivery_token>();
+  }
+};
+} // namespace mqtt
+
+#endif
@@ -0,0 +1,36 @@
+// Stand-in for trunk-recorder's Plugin_Api, for the payload regression test.
+
+#ifndef MQTT_STATUS_TEST_PLUGIN_API_H
+#define MQTT_STATUS_TEST_PLUGIN_API_H
+
+#include <trunk-recorder/source.h>
+
+class Plugin_Api
+{
+public:
+  virtual int init(Config *config, std::vector<Source *> sources, std::vector<System *> systems) { return 0; }
+  virtual int parse_config(json config_data) { return 0; }
+  virtual int start() { return 0; }
+  virtual int stop() { return 0; }
+  virtual int poll_one() { return 0; }
+  virtual int call_start(Call *call) { return 0; }
+  virtual int call_end(Call_Data_t call_info) { return 0; }
+  virtual int calls_active(std::vector<Call *> calls) { return 0; }
+  virtual int setup_recorder(Recorder *recorder) { return 0; }
+  virtual int setup_system(System *system) { return 0; }
+  virtual int setup_systems(std::vector<System *> systems) { return 0; }
+  virtual int setup_sources(std::vector<Source *> sources) { return 0; }
+  virtual int setup_config(std::vector<Source *> sources, std::vector<System *> systems) { return 0; }
+  virtual int system_rates(std::vector<System *> systems, float timeDiff) { return 0; }
+  virtual int unit_registration(System *sys, long source_id) { return 0; }
+  virtual int unit_deregistration(System *sys, long source_id) { return 0; }
+  virtual int unit_acknowledge_response(System *sys, long source_id) { return 0; }
+  virtual int unit_group_affiliation(System *sys, long source_id, long talkgroup_num) { return 0; }
+  virtual int unit_data_grant(System *sys, long source_id) { return 0; }
+  virtual int unit_answer_request(System *sys, long source_id, long talkgroup) { return 0; }
+  virtual int unit_location(System *sys, long source_id, long talkgroup_num) { return 0; }
+  virtual int trunk_message(std::vector<TrunkMessage> messages, System *system) { return 0; }
+  virtual ~Plugin_Api() {}
+};
+
+#endif
@@ -0,0 +1,397 @@
+// Stand-ins for the trunk-recorder classes used by the plugin, for the payload regression test.
+//   Only the members the plugin reads are declared.  Getters return public fields so a test can set up
+//   calls, recorders, systems, and sources directly.  Keep the signatures in step with trunk-recorder.
+
+#ifndef MQTT_STATUS_TEST_SOURCE_H
+#define MQTT_STATUS_TEST_SOURCE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+extern int frequency_format;
+std::string log_header(std::string short_name, long call_num, std::string talkgroup_display, double freq);
+
+enum State { MONITORING = 0, RECORDING = 1, INACTIVE = 2, ACTIVE = 3, IDLE = 4, STOPPED = 6, AVAILABLE = 7, IGNORE = 8 };
+enum Monitoring_State { UNSPECIFIED = 0, UNKNOWN_TG = 1, IGNORED_TG = 2, NO_SOURCE = 3, NO_RECORDER = 4, ENCRYPTED = 5, DUPLICATE = 6, SUPERSEDED = 7 };
+enum MessageType { GRANT = 0, STATUS = 1, UPDATE = 2, CONTROL_CHANNEL = 3, REGISTRATION = 4, DEREGISTRATION = 5, AFFILIATION = 6, SYSID = 7, ACKNOWLEDGE = 8, LOCATION = 9, PATCH_ADD = 10, PATCH_DELETE = 11, DATA_GRANT = 12, UU_ANS_REQ = 13, UU_V_GRANT = 14, UU_V_UPDATE = 15, UNKNOWN = 99 };
+
+struct PatchData
+{
+  unsigned long sg;
+  unsigned long ga1;
+  unsigned long ga2;
+  unsigned long ga3;
+};
+
+struct TrunkMessage
+{
+  MessageType message_type;
+  std::string meta;
+  double freq;
+  long talkgroup;
+  bool encrypted;
+  bool emergency;
+  long source;
+  int sys_num;
+  unsigned long sys_id;
+  unsigned long nac;
+  unsigned long wacn;
+  int opcode;
+  PatchData patch_data;
+  bool phase2_tdma;
+  int tdma_slot;
+};
+
+struct Gain_Stage_t
+{
+  std::string stage_name;
+  int value;
+};
+
+struct Talkgroup
+{
+  std::string alpha_tag;
+  std::string description;
+  std::string group;
+  std::string tag;
+};
+
+struct Call_Source
+{
+  long source;
+  long time;
+  double position;
+  bool emergency;
+  std::string signal_system;
+  std::string tag;
+};
+
+struct Transmission
+{
+  long source;
+  long start_time;
+  long stop_time;
+  long sample_count;
+  long spike_count;
+  long error_count;
+  double freq;
+  double length;
+  char filename[300];
+};
+
+struct Call_Data_t
+{
+  long talkgroup;
+  std::vector<unsigned long> patched_talkgroups;
+  std::string talkgroup_tag;
+  std::string talkgroup_alpha_tag;
+  std::string talkgroup_description;
+  std::string talkgroup_group;
+  std::string talkgroup_display;
+  long call_num;
+  double freq;
+  long start_time;
+  long stop_time;
+  bool encrypted;
+  bool emergency;
+  char filename[300];
+  char converted[300];
+  std::string short_name;
+  std::string upload_script;
+  std::string audio_type;
+  int tdma_slot;
+  bool phase2_tdma;
+  long error_count;
+  long spike_count;
+  long freq_error;
+  double signal;
+  double noise;
+  int recorder_num;
+  int source_num;
+  double length;
+  bool compress_wav;
+  int sys_num;
+  nlohmann::ordered_json call_json;
+  long process_call_time;
+  int retry_attempt;
+  std::vector<Call_Source> transmission_source_list;
+  std::vector<Transmission> transmission_list;
+};
+
+class Source;
+class System;
+
+class Recorder
+{
+public:
+  int num = 0;
+  State state = AVAILABLE;
+  double freq = 0;
+  Source *source = nullptr;
+  bool squelched = true;
+  bool analog = false;
+  double current_length = 0;
+  std::string type_string = "P25";
+  int count = 0;
+  double duration = 0;
+
+  virtual ~Recorder() {}
+  virtual int get_num() { return num; }
+  virtual State get_state() { return state; }
+  virtual double get_freq() { return freq; }
+  virtual Source *get_source() { return source; }
+  virtual bool is_squelched() { return squelched; }
+  virtual bool is_analog() { return analog; }
+  virtual double get_current_length() { return current_length; }
+  std::string get_type_string() { return type_string; }
+  boost::property_tree::ptree get_stats();
+};
+
+class Call
+{
+public:
+  System *system = nullptr;
+  long call_num = 0;
+  int sys_num = 0;
+  std::string short_name;
+  double freq = 0;
+  long source_id = 0;
+  long talkgroup = 0;
+  std::string talkgroup_display;
+  double current_length = 0;
+  State state = RECORDING;
+  Monitoring_State monitoring_state = UNSPECIFIED;
+  bool phase2_tdma = false;
+  int tdma_slot = 0;
+  bool analog = false;
+  bool conventional = false;
+  bool encrypted = false;
+  bool emergency = false;
+  long start_time = 0;
+  long stop_time = 0;
+  Recorder *recorder = nullptr;
+
+  virtual ~Call() {}
+  boost::property_tree::ptree get_stats();
+  System *get_system() { return system; }
+  long get_call_num() { return call_num; }
+  int get_sys_num() { return sys_num; }
+  std::string get_short_name() { return short_name; }
+  double get_freq() { return freq; }
+  long get_current_source_id() { return source_id; }
+  long get_talkgroup() { return talkgroup; }
+  std::string get_talkgroup_display() { return talkgroup_display; }
+  double get_current_length() { return current_length; }
+  State get_state() { return state; }
+  Monitoring_State get_monitoring_state() { return monitoring_state; }
+  bool get_phase2_tdma() { return phase2_tdma; }
+  int get_tdma_slot() { return tdma_slot; }
+  bool get_is_analog() { return analog; }
+  bool is_conventional() { return conventional; }
+  bool get_encrypted() { return encrypted; }
+  bool get_emergency() { return emergency; }
+  long get_start_time() { return start_time; }
+  long get_stop_time() { return stop_time; }
+  Recorder *get_recorder() { return recorder; }
+};
+
+class System
+{
+public:
+  int sys_num = 0;
+  std::string short_name;
+  std::string system_type = "p25";
+  std::string talkgroups_file;
+  bool qpsk_mod = true;
+  double squelch_db = 0;
+  double analog_levels = 8;
+  double digital_levels = 1;
+  bool audio_archive = true;
+  std::string upload_script;
+  bool record_unknown = true;
+  bool call_log = true;
+  std::vector<double> channels;
+  std::vector<double> control_channels;
+  double current_control_channel = 0;
+  std::string bandplan = "800_standard";
+  int bandfreq = 800;
+  double bandplan_base = 0;
+  double bandplan_high = 0;
+  double bandplan_spacing = 0;
+  int bandplan_offset = 0;
+  double decoderate = 0;
+  int sys_rfss = 0;
+  int sys_site_id = 0;
+  unsigned long sys_id = 0;
+  unsigned long wacn = 0;
+  unsigned long nac = 0;
+  std::map<long, std::string> unit_tags;
+  std::map<long, Talkgroup> talkgroups;
+  std::map<unsigned long, std::vector<unsigned long>> talkgroup_patches;
+
+  virtual ~System() {}
+  int get_sys_num() { return sys_num; }
+  std::string get_short_name() { return short_name; }
+  std::string get_system_type() { return system_type; }
+  std::string get_talkgroups_file() { return talkgroups_file; }
+  bool get_qpsk_mod() { return qpsk_mod; }
+  double get_squelch_db() { return squelch_db; }
+  double get_analog_levels() { return analog_levels; }
+  double get_digital_levels() { return digital_levels; }
+  bool get_audio_archive() { return audio_archive; }
+  std::string get_upload_script() { return upload_script; }
+  bool get_record_unknown() { return record_unknown; }
+  bool get_call_log() { return call_log; }
+  std::vector<double> get_channels() { return channels; }
+  std::vector<double> get_control_channels() { return control_channels; }
+  double get_current_control_channel() { return current_control_channel; }
+  std::string get_bandplan() { return bandplan; }
+  int get_bandfreq() { return bandfreq; }
+  double get_bandplan_base() { return bandplan_base; }
+  double get_bandplan_high() { return bandplan_high; }
+  double get_bandplan_spacing() { return bandplan_spacing; }
+  int get_bandplan_offset() { return bandplan_offset; }
+  boost::property_tree::ptree get_stats()
+  {
+    boost::property_tree::ptree node;
+    node.put("id", sys_num);
+    node.put("name", short_name);
+    node.put("type", system_type);
+    node.put("sysid", sys_id);
+    node.put("wacn", wacn);
+    node.put("nac", nac);
+    return node;
+  }
+  boost::property_tree::ptree get_stats_current(float timeDiff)
+  {
+    boost::property_tree::ptree node;
+    node.put("decoderate", decoderate);
+    return node;
+  }
+  int get_sys_rfss() { return sys_rfss; }
+  int get_sys_site_id() { return sys_site_id; }
+  unsigned long get_sys_id() { return sys_id; }
+  unsigned long get_wacn() { return wacn; }
+  unsigned long get_nac() { return nac; }
+  std::string find_unit_tag(long unit)
+  {
+    std::map<long, std::string>::iterator it = unit_tags.find(unit);
+    return (it == unit_tags.end()) ? "" : it->second;
+  }
+  Talkgroup *find_talkgroup(long talkgroup)
+  {
+    std::map<long, Talkgroup>::iterator it = talkgroups.find(talkgroup);
+    return (it == talkgroups.end()) ? nullptr : &it->second;
+  }
+  std::vector<unsigned long> get_talkgroup_patch(unsigned long talkgroup)
+  {
+    std::map<unsigned long, std::vector<unsigned long>>::iterator it = talkgroup_patches.find(talkgroup);
+    return (it == talkgroup_patches.end()) ? std::vector<unsigned long>() : it->second;
+  }
+};
+
+class Source
+{
+public:
+  int num = 0;
+  double rate = 2048000;
+  double center = 0;
+  double min_hz = 0;
+  double max_hz = 0;
+  double error = 0;
+  std::string driver = "osmosdr";
+  std::string device = "rtl=0";
+  std::string antenna;
+  int gain = 0;
+  int analog_recorders = 0;
+  int digital_recorders = 0;
+  std::vector<Gain_Stage_t> gain_stages;
+  std::vector<Recorder *> recorders;
+
+  std::vector<Gain_Stage_t> get_gain_stages() { return gain_stages; }
+  int get_num() { return num; }
+  double get_rate() { return rate; }
+  double get_center() { return center; }
+  double get_min_hz() { return min_hz; }
+  double get_max_hz() { return max_hz; }
+  double get_error() { return error; }
+  std::string get_driver() { return driver; }
+  std::string get_device() { return device; }
+  std::string get_antenna() { return antenna; }
+  int get_gain() { return gain; }
+  int analog_recorder_count() { return analog_recorders; }
+  int digital_recorder_count() { return digital_recorders; }
+  int debug_recorder_count() { return 0; }
+  int sigmf_recorder_count() { return 0; }
+  int get_silence_frames() { return 0; }
+  std::vector<Recorder *> get_recorders() { return recorders; }
+};
+
+// get_stats() builds the same property tree as trunk-recorder, so the benchmark can compare against it
+inline boost::property_tree::ptree Recorder::get_stats()
+{
+  boost::property_tree::ptree node;
+  node.put("id", boost::lexical_cast<std::string>(source->get_num()) + "_" + boost::lexical_cast<std::string>(num));
+  node.put("type", type_string);
+  node.put("srcNum", source->get_num());
+  node.put("recNum", num);
+  node.put("count", count);
+  node.put("duration", duration);
+  node.put("state", state);
+  node.put("status_len", current_length);
+  node.put("status_error", 0);
+  node.put("status_spike", 0);
+  return node;
+}
+
+inline boost::property_tree::ptree Call::get_stats()
+{
+  boost::property_tree::ptree node;
+  node.put("id", boost::lexical_cast<std::string>(sys_num) + "_" + boost::lexical_cast<std::string>(talkgroup) + "_" + boost::lexical_cast<std::string>(start_time));
+  node.put("callNum", call_num);
+  node.put("freq", freq);
+  node.put("sysNum", sys_num);
+  node.put("shortName", short_name);
+  node.put("talkgroup", talkgroup);
+  node.put("talkgrouptag", talkgroup_display);
+  node.put("elapsed", time(NULL) - start_time);
+  node.put("length", current_length);
+  node.put("state", state);
+  node.put("monState", monitoring_state);
+  node.put("phase2", phase2_tdma);
+  node.put("conventional", conventional);
+  node.put("encrypted", encrypted);
+  node.put("emergency", emergency);
+  node.put("startTime", start_time);
+  node.put("stopTime", stop_time);
+  node.put("srcId", source_id);
+  if (recorder != nullptr)
+  {
+    node.put("recNum", recorder->get_num());
+    node.put("srcNum", recorder->get_source()->get_num());
+    node.put("recState", recorder->get_state());
+    node.put("analog", recorder->is_analog());
+  }
+  return node;
+}
+
+struct Config
+{
+  std::string capture_dir;
+  std::string upload_server;
+  int call_timeout;
+  bool log_file;
+  std::string instance_id;
+  std::string instance_key;
+  bool broadcast_signals;
+  int frequency_format;
+};
+
+#endif